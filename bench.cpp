@@ -0,0 +1,361 @@
+// bench.cpp
+// Headless benchmark for the search pipeline of colossus_pkgcenter.cpp.
+//
+// Replays `yay -Ss` output through the same code the GUI runs, stage by
+// stage: ANSI/OSC stripping, parsing, installed-status resolution and
+// results-list population (ranking plus list store rows). Fixtures of 10,
+// 1k and 20k results are generated with and without colour codes; real
+// captures can be replayed too:
+//
+//   yay -Ss --color always python > python.txt
+//   ./colossus-pkgcenter-bench python.txt
+//
+// `--trace=FILE` records the app's own trace events (see --trace in the
+// GUI) for all runs, as Chrome trace-event JSON.
+//
+// Before benchmarking it checks vercmp() against pacman's vercmptest
+// cases and exits 1 if any fail; `--check` does only that (`make check`).
+//
+// For each stage it prints p50/p99 latency, throughput and C++ heap
+// allocations per run (GLib's own allocations are not counted).
+//
+// Build:
+//   make bench
+
+#define COLOSSUS_NO_MAIN
+#include "colossus_pkgcenter.cpp"
+
+#include <chrono>
+#include <cinttypes>
+#include <fstream>
+#include <new>
+
+// ───────────────────────────────────────────────
+//  Allocation counting
+// ───────────────────────────────────────────────
+
+static std::atomic<uint64_t> g_bench_allocs{0};
+
+void *operator new(size_t size) {
+    g_bench_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+// Out of line, so GCC does not see malloc paired with free and warn.
+__attribute__((noinline)) void operator delete(void *p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete[](void *p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept { free(p); }
+__attribute__((noinline)) void operator delete[](void *p, size_t) noexcept { free(p); }
+
+// ───────────────────────────────────────────────
+//  Fixtures
+// ───────────────────────────────────────────────
+
+struct Fixture {
+    std::string label;
+    std::string output;   // raw yay -Ss output
+    std::string query;    // what g_shown_query is set to for ranking
+};
+
+// Deterministic, so runs are comparable.
+static uint32_t bench_random(uint32_t &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Output shaped like yay's: "repo/name version ..." headers (AUR ones with
+// votes, some installed) followed by an indented description. With
+// `color`, the escapes yay uses on a terminal, OSC 8 links included.
+static std::string generate_yay_output(size_t count, bool color) {
+    static const char *const prefixes[] = {
+        "python", "lib", "gtk", "qt5", "rust", "ttf", "gnome", "kde", "vim", "perl",
+    };
+    static const char *const words[] = {
+        "core", "utils", "theme", "bindings", "git", "bin", "docs", "plugin", "tools", "extra",
+    };
+    static const char *const repos[] = { "core", "extra", "multilib", "aur", "aur", "aur" };
+
+    uint32_t rng = 0x9E3779B9u;
+    std::string out;
+    for (size_t i = 0; i < count; i++) {
+        std::string repo = repos[bench_random(rng) % 6];
+        std::string name = std::string(prefixes[bench_random(rng) % 10]) + "-" +
+                           words[bench_random(rng) % 10] + std::to_string(i);
+        std::string version = std::to_string(bench_random(rng) % 20) + "." +
+                              std::to_string(bench_random(rng) % 100) + "-1";
+        bool is_aur = repo == "aur";
+        bool installed = i % 7 == 0;
+
+        if (color) {
+            out += "\x1b[1m\x1b[35m" + repo + "\x1b[0m/\x1b[1m";
+            if (is_aur) {
+                out += "\x1b]8;;https://aur.archlinux.org/packages/" + name + "\x1b\\" + name +
+                       "\x1b]8;;\x1b\\";
+            } else {
+                out += name;
+            }
+            out += "\x1b[0m \x1b[1m\x1b[32m" + version + "\x1b[0m";
+        } else {
+            out += repo + "/" + name + " " + version;
+        }
+        if (is_aur) out += " (+" + std::to_string(bench_random(rng) % 5000) + " 1.23)";
+        else out += " (1.2 MiB 4.8 MiB)";
+        if (installed) out += color ? " \x1b[1m\x1b[36m(Installed)\x1b[0m" : " (Installed)";
+        out += "\n    ";
+        out += "A package for benchmarking the search pipeline, entry " + std::to_string(i) +
+               ", with a description about as long as a typical one";
+        out += "\n";
+    }
+    return out;
+}
+
+// Mark every 7th generated name (or a file's every 7th result) installed,
+// without touching the real local DB.
+static void seed_installed_index(const PackageList &pkgs) {
+    std::unordered_map<std::string, std::string> index;
+    for (size_t i = 0; i < pkgs.size(); i += 7) {
+        index[std::string(pkgs.items[i].name)] = "1.0-1";
+    }
+    set_installed_index(std::move(index));
+}
+
+// ───────────────────────────────────────────────
+//  Measurement
+// ───────────────────────────────────────────────
+
+static double now_ms() {
+    using clock = std::chrono::steady_clock;
+    return std::chrono::duration<double, std::milli>(clock::now().time_since_epoch()).count();
+}
+
+struct StageResult {
+    std::vector<double> ms;
+    uint64_t allocs = 0;
+};
+
+// Run `stage` until about `budget_ms` has passed (at least 5, at most
+// 2000 times), after one untimed warm-up run.
+template <typename Fn>
+static StageResult measure(Fn &&stage, double budget_ms) {
+    stage();
+
+    StageResult result;
+    double start = now_ms();
+    uint64_t allocs = g_bench_allocs.load();
+    while (result.ms.size() < 5 ||
+           (now_ms() - start < budget_ms && result.ms.size() < 2000)) {
+        double t0 = now_ms();
+        stage();
+        result.ms.push_back(now_ms() - t0);
+    }
+    result.allocs = (g_bench_allocs.load() - allocs) / result.ms.size();
+    return result;
+}
+
+static double percentile(std::vector<double> v, double p) {
+    std::sort(v.begin(), v.end());
+    size_t i = static_cast<size_t>(p * static_cast<double>(v.size() - 1) + 0.5);
+    return v[std::min(i, v.size() - 1)];
+}
+
+static void report(const Fixture &fx, const char *stage, const StageResult &r,
+                   size_t bytes, size_t rows) {
+    double p50 = percentile(r.ms, 0.50);
+    double p99 = percentile(r.ms, 0.99);
+    double mb_s = p50 > 0 ? static_cast<double>(bytes) / 1e6 / (p50 / 1000.0) : 0;
+    double rows_s = p50 > 0 ? static_cast<double>(rows) / (p50 / 1000.0) : 0;
+    printf("%-22s %-10s %6zu %10.3f %10.3f %10.1f %12.0f %12" PRIu64 "\n",
+           fx.label.c_str(), stage, r.ms.size(), p50, p99, mb_s, rows_s, r.allocs);
+}
+
+static void bench_fixture(const Fixture &fx, double budget_ms) {
+    const std::string &raw = fx.output;
+
+    StageResult strip = measure([&] {
+        std::string copy = raw;
+        copy = strip_ansi_and_osc(std::move(copy));
+    }, budget_ms);
+
+    PackageList parsed = parse_yay_search(raw);
+    StageResult parse = measure([&] { PackageList pkgs = parse_yay_search(raw); }, budget_ms);
+
+    seed_installed_index(parsed);
+    StageResult installed = measure([&] {
+        for (auto &pkg : parsed.items) pkg.set_installed(is_package_installed(pkg.name));
+    }, budget_ms);
+
+    // Ranking plus the first page of rows, and then every page, the way
+    // scrolling to the end would add them.
+    g_shown_query = fx.query;
+    StageResult rows = measure([&] {
+        show_matches(parsed);
+        while (g_fill_rows_id) g_main_context_iteration(nullptr, FALSE);
+    }, budget_ms);
+    StageResult all_rows = measure([&] {
+        show_matches(parsed);
+        for (;;) {
+            while (g_fill_rows_id) g_main_context_iteration(nullptr, FALSE);
+            size_t shown = g_results.size();
+            show_more_matches();
+            if (g_results.size() == shown && !g_fill_rows_id) break;
+        }
+    }, budget_ms);
+
+    size_t n = parsed.size();
+    report(fx, "strip", strip, raw.size(), n);
+    report(fx, "parse", parse, raw.size(), n);
+    report(fx, "installed", installed, 0, n);
+    report(fx, "rows", rows, 0, std::min(n, RESULT_PAGE_SIZE));
+    report(fx, "rows(all)", all_rows, 0, n);
+    fflush(stdout);
+}
+
+// ───────────────────────────────────────────────
+//  Version comparison self-check
+// ───────────────────────────────────────────────
+
+// From pacman's test/util/vercmptest.sh; each pair is also checked the
+// other way round. Without libalpm these decide "update available" and
+// which cached versions are pruned.
+struct VercmpCase {
+    const char *a;
+    const char *b;
+    int expected;
+};
+
+static const VercmpCase vercmp_cases[] = {
+    // all similar length, no pkgrel
+    { "1.5.0", "1.5.0", 0 }, { "1.5.1", "1.5.0", 1 },
+    // mixed length
+    { "1.5.1", "1.5", 1 },
+    // with pkgrel, simple
+    { "1.5.0-1", "1.5.0-1", 0 }, { "1.5.0-1", "1.5.0-2", -1 },
+    { "1.5.0-1", "1.5.1-1", -1 }, { "1.5.0-2", "1.5.1-1", -1 },
+    // with pkgrel, mixed lengths
+    { "1.5-1", "1.5.1-1", -1 }, { "1.5-2", "1.5.1-1", -1 }, { "1.5-2", "1.5.1-2", -1 },
+    // mixed pkgrel inclusion
+    { "1.5", "1.5-1", 0 }, { "1.5-1", "1.5", 0 }, { "1.1-1", "1.1", 0 },
+    { "1.0-1", "1.1", -1 }, { "1.1-1", "1.0", 1 },
+    // alphanumeric versions
+    { "1.5b-1", "1.5-1", -1 }, { "1.5b", "1.5", -1 }, { "1.5b-1", "1.5", -1 }, { "1.5b", "1.5.1", -1 },
+    // from the manpage
+    { "1.0a", "1.0alpha", -1 }, { "1.0alpha", "1.0b", -1 }, { "1.0b", "1.0beta", -1 },
+    { "1.0beta", "1.0rc", -1 }, { "1.0rc", "1.0", -1 },
+    // alpha-dotted versions
+    { "1.5.a", "1.5", 1 }, { "1.5.b", "1.5.a", 1 }, { "1.5.1", "1.5.b", 1 },
+    // alpha dots and dashes
+    { "1.5.b-1", "1.5.b", 0 }, { "1.5-1", "1.5.b", -1 },
+    // same/similar content, differing separators
+    { "2.0", "2_0", 0 }, { "2.0_a", "2_0.a", 0 }, { "2.0a", "2.0.a", -1 }, { "2___a", "2_a", 1 },
+    // epoch included version comparisons
+    { "0:1.0", "0:1.0", 0 }, { "0:1.0", "0:1.1", -1 }, { "1:1.0", "0:1.0", 1 },
+    { "1:1.0", "0:1.1", 1 }, { "1:1.0", "2:1.1", -1 },
+    // epoch + sometimes present pkgrel
+    { "1:1.0", "0:1.0-1", 1 }, { "1:1.0-1", "0:1.1-1", 1 },
+    // epoch included on one version
+    { "0:1.0", "1.0", 0 }, { "0:1.1", "1.0", 1 }, { "0:1.1", "1.1", 0 },
+    { "1:1.0", "1.0", 1 }, { "1:1.1", "1.1", 1 }, { "1:1.1", "1.11", 1 },
+    // '~' is only a separator to pacman, unlike dpkg's "sorts first"
+    { "1.0~rc1", "1.0.rc1", 0 }, { "1.0~rc1", "1.0", 1 }, { "1.0~rc1", "1.0rc1", 1 },
+};
+
+static int sign(int v) { return (v > 0) - (v < 0); }
+
+// Number of failed comparisons, each printed.
+static int check_vercmp() {
+    int failures = 0;
+    for (const auto &c : vercmp_cases) {
+        int forward = sign(vercmp(c.a, c.b));
+        int backward = sign(vercmp(c.b, c.a));
+        if (forward == c.expected && backward == -c.expected) continue;
+        fprintf(stderr, "vercmp %s %s: got %d / %d, expected %d\n",
+                c.a, c.b, forward, backward, c.expected);
+        failures++;
+    }
+    return failures;
+}
+
+static bool read_file(const char *path, std::string &out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    out = ss.str();
+    return true;
+}
+
+int main(int argc, char **argv) {
+    bool check_only = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--check") == 0) check_only = true;
+    }
+    if (int failures = check_vercmp()) {
+        fprintf(stderr, "bench: %d vercmp cases failed\n", failures);
+        return 1;
+    }
+    if (check_only) {
+        printf("vercmp: %zu cases ok\n", G_N_ELEMENTS(vercmp_cases));
+        return 0;
+    }
+
+    // Only the list store is needed, not a display.
+    g_results_store = gtk_list_store_new(RESULT_N_COLS, G_TYPE_UINT);
+    g_search_jobs = new JobQueue();
+    g_index_jobs = new JobQueue();
+    g_aur_jobs = new JobQueue();
+
+    double budget_ms = 500;
+    if (const char *env = g_getenv("COLOSSUS_BENCH_MS")) budget_ms = g_ascii_strtod(env, nullptr);
+
+    std::vector<Fixture> fixtures;
+    std::vector<const char *> files;
+    for (int i = 1; i < argc; i++) {
+        if (g_str_has_prefix(argv[i], "--trace=")) g_trace_file = argv[i] + strlen("--trace=");
+        else if (strcmp(argv[i], "--check") != 0) files.push_back(argv[i]);
+    }
+    g_trace_enabled = !g_trace_file.empty();
+
+    if (!files.empty()) {
+        for (const char *file : files) {
+            Fixture fx;
+            if (!read_file(file, fx.output)) {
+                fprintf(stderr, "bench: cannot read %s\n", file);
+                return 1;
+            }
+            gchar *base = g_path_get_basename(file);
+            fx.label = base;
+            g_free(base);
+            fx.query = fx.label.substr(0, fx.label.find('.'));
+            fixtures.push_back(std::move(fx));
+        }
+    } else {
+        for (size_t count : { size_t(10), size_t(1000), size_t(20000) }) {
+            for (bool color : { false, true }) {
+                Fixture fx;
+                fx.label = std::to_string(count) + (color ? " results, ansi" : " results");
+                fx.output = generate_yay_output(count, color);
+                fx.query = "python";
+                fixtures.push_back(std::move(fx));
+            }
+        }
+    }
+
+    printf("%-22s %-10s %6s %10s %10s %10s %12s %12s\n",
+           "fixture", "stage", "runs", "p50 ms", "p99 ms", "MB/s", "rows/s", "allocs/run");
+    for (const auto &fx : fixtures) bench_fixture(fx, budget_ms);
+
+    clear_results();
+    g_object_unref(g_results_store);
+    delete g_search_jobs;
+    delete g_index_jobs;
+    delete g_aur_jobs;
+    if (!g_trace_file.empty() && !write_chrome_trace(g_trace_file)) return 1;
+    return 0;
+}
@@ -3,671 +3,7540 @@
 //
 // Features:
 // - GTK3 UI that follows system theme
-// - On startup asks for sudo password (cached in RAM)
-// - Search via `yay -Ss` as normal user
+// - Window first, indexes preloaded behind it; the sudo password is asked
+//   for by the first install/remove/clean (cached in RAM); sudo is
+//   validated once and its timestamp refreshed every minute
+// - Search from an in-memory index of the sync DBs and the AUR metadata
+//   dump. Until it is ready, repos are searched with `pacman -Ss` and the
+//   AUR through its RPC (libcurl, one kept-alive connection); regex
+//   queries still go to `yay -Ss`. The index is saved to disk and
+//   memory-mapped on the next start.
+// - Results ranked by name match, installed status and AUR votes; shown a
+//   page at a time
+// - Details pane for the row under the cursor (pacman -Qi/-Si or the AUR
+//   RPC, fetched on demand and cached)
 // - Install/remove via yay as normal user (after sudo pre-auth)
-// - "Clean Orphans" button runs `yay -Yc --noconfirm`
-// - UI stays responsive during long operations.
+// - Removal preview from an in-memory dependency graph of the local DB
+//   (kept current incrementally): what else goes, what would break
+// - "Clean Orphans" works out the orphans from the local DB, previews them
+//   with their sizes and removes the confirmed ones in one `pacman -Rn`
+// - "Package Cache" sizes up pacman's, our download and yay's build caches
+//   (threaded, incremental by directory mtime) and prunes them like
+//   paccache: keep the newest N versions, optionally none of uninstalled
+// - "Updates" lists pending repo and AUR upgrades (checkupdates-style
+//   private sync DB refresh, versions compared in-process); "Upgrade All"
+//   runs one `yay -Syu`
+// - Multi-select queue: installs and removals applied as one yay call each
+// - Repo packages are downloaded in parallel (pacman.conf ParallelDownloads,
+//   or $COLOSSUS_PARALLEL_DOWNLOADS) with a progress window, overlapping
+//   with AUR builds queued ahead of them
+// - Several queued AUR packages are built side by side with makepkg
+//   (dependency order from .SRCINFO, $COLOSSUS_BUILD_CORES core budget)
+// - Commands are spawned without a shell and their output is read from
+//   the main loop, so the UI stays responsive during long operations.
+// - Command log pane with their output (last 50k lines); every transaction
+//   is also logged to $XDG_STATE_HOME/colossus-pkgcenter/logs
 //
 // Build (Arch):
 //   sudo pacman -S gtk3 base-devel
-//   g++ colossus_pkgcenter.cpp -o colossus-pkgcenter `pkg-config --cflags --libs gtk+-3.0`
+//   g++ colossus_pkgcenter.cpp -o colossus-pkgcenter `pkg-config --cflags --libs gtk+-3.0 libcurl`
+//
+// Optional: with libalpm's pkg-config file present, `make` builds with
+// -DCOLOSSUS_WITH_ALPM and queries the pacman DBs in-process.
+// With sysprof-capture-4, -DCOLOSSUS_WITH_SYSPROF also sends the --trace
+// timings to sysprof as marks.
 //
 // Run:
 //   ./colossus-pkgcenter
+//   ./colossus-pkgcenter --trace=trace.json   # Chrome trace of the hot paths
+//   ./colossus-pkgcenter --trace-overlay      # latest timings in the status bar
+//   ./colossus-pkgcenter --search TERM...     # no window; see "Command line"
+//   ./colossus-pkgcenter --install PKG...
+//   ./colossus-pkgcenter --service            # keep the index warm on D-Bus
 
 #include <gtk/gtk.h>
+#include <glib-unix.h>
+#include <glib/gstdio.h>
+#include <curl/curl.h>
+#ifdef COLOSSUS_WITH_ALPM
+#include <alpm.h>
+#endif
+#ifdef COLOSSUS_WITH_SYSPROF
+#include <sysprof-capture.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 #include <string>
 #include <vector>
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <cstring>
+#include <string_view>
 #include <cstdio>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 // ───────────────────────────────────────────────
-//  Simple command runners
+//  Tracing
 // ───────────────────────────────────────────────
 
-// Capture stdout, but keep GTK responsive while reading
-std::string run_command(const std::string &cmd) {
-    std::string result;
-    FILE *pipe = popen(cmd.c_str(), "r");
-    if (!pipe) return result;
+// Timings for the hot paths: child processes, parsing, index queries,
+// installed checks, ranking and row population, transactions. Off unless
+// asked for: `--trace=FILE` writes them as Chrome trace-event JSON on exit
+// (chrome://tracing or Perfetto), `--trace-overlay` shows the latest ones
+// in the status bar, and builds with sysprof-capture also send them to
+// sysprof as marks. Only the last TRACE_RING_SIZE events are kept.
+struct TraceEvent {
+    const char *name = nullptr;  // string literal
+    std::string detail;
+    gint64 start_us = 0;         // g_get_monotonic_time()
+    gint64 dur_us = 0;
+    unsigned thread = 0;
+};
+
+static const size_t TRACE_RING_SIZE = 16384;
+
+static std::atomic<bool> g_trace_enabled{false};
+static std::string g_trace_file;
+static bool g_trace_overlay = false;
+
+// When main() started; the startup milestones (see startup_milestone) are
+// measured from here.
+static gint64 g_startup_us = 0;
+
+static std::mutex g_trace_mutex;
+static std::vector<TraceEvent> g_trace_ring;  // circular once full
+static size_t g_trace_count = 0;              // events recorded so far
+
+static inline bool tracing() {
+    return g_trace_enabled.load(std::memory_order_relaxed);
+}
+
+// Start time for trace_record, or 0 when tracing is off.
+static inline gint64 trace_start() {
+    return tracing() ? g_get_monotonic_time() : 0;
+}
+
+static unsigned trace_thread_id() {
+    static std::atomic<unsigned> next{1};
+    thread_local unsigned id = next++;
+    return id;
+}
+
+// Record `name` as having run from `start_us` (see trace_start) until now.
+void trace_record(const char *name, gint64 start_us, std::string detail = std::string()) {
+    if (!start_us || !tracing()) return;
+
+    TraceEvent ev;
+    ev.name = name;
+    ev.detail = std::move(detail);
+    ev.start_us = start_us;
+    ev.dur_us = g_get_monotonic_time() - start_us;
+    ev.thread = trace_thread_id();
+
+#ifdef COLOSSUS_WITH_SYSPROF
+    sysprof_collector_mark(ev.start_us * 1000, ev.dur_us * 1000, "colossus", name,
+                           "%s", ev.detail.c_str());
+#endif
+
+    std::lock_guard<std::mutex> lock(g_trace_mutex);
+    if (g_trace_ring.size() < TRACE_RING_SIZE) {
+        g_trace_ring.push_back(std::move(ev));
+    } else {
+        g_trace_ring[g_trace_count % TRACE_RING_SIZE] = std::move(ev);
+    }
+    g_trace_count++;
+}
+
+// Times the enclosing scope.
+class TraceScope {
+public:
+    explicit TraceScope(const char *name, std::string detail = std::string())
+        : name_(name), detail_(std::move(detail)), start_(trace_start()) {}
+    ~TraceScope() { trace_record(name_, start_, std::move(detail_)); }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *name_;
+    std::string detail_;
+    gint64 start_;
+};
 
-    char buffer[4096];
-    while (fgets(buffer, sizeof(buffer), pipe)) {
-        result += buffer;
+// The newest `max` events (all of them by default), oldest first.
+static std::vector<TraceEvent> trace_snapshot(size_t max = TRACE_RING_SIZE) {
+    std::lock_guard<std::mutex> lock(g_trace_mutex);
+    size_t n = std::min(max, g_trace_ring.size());
+    std::vector<TraceEvent> events;
+    events.reserve(n);
+    for (size_t i = g_trace_count - n; i < g_trace_count; i++) {
+        events.push_back(g_trace_ring[i % TRACE_RING_SIZE]);
+    }
+    return events;
+}
 
-        // Keep GTK responsive
-        while (gtk_events_pending()) {
-            gtk_main_iteration_do(FALSE);
+static std::string json_escape(std::string_view s) {
+    std::string out;
+    for (char c : s) {
+        unsigned char u = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if (u < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", u);
+            out += buf;
+        } else {
+            out.push_back(c);
         }
     }
-    pclose(pipe);
-    return result;
+    return out;
+}
+
+// Complete ("X") events in the Chrome trace-event format.
+static bool write_chrome_trace(const std::string &path) {
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto &ev : trace_snapshot()) {
+        if (!first) json += ",";
+        first = false;
+        json += "\n{\"name\":\"" + json_escape(ev.name) + "\",\"cat\":\"colossus\",\"ph\":\"X\"";
+        json += ",\"ts\":" + std::to_string(ev.start_us) + ",\"dur\":" + std::to_string(ev.dur_us);
+        json += ",\"pid\":" + std::to_string(getpid()) + ",\"tid\":" + std::to_string(ev.thread);
+        if (!ev.detail.empty()) json += ",\"args\":{\"detail\":\"" + json_escape(ev.detail) + "\"}";
+        json += "}";
+    }
+    json += "\n]}\n";
+
+    GError *error = nullptr;
+    if (!g_file_set_contents(path.c_str(), json.data(), static_cast<gssize>(json.size()), &error)) {
+        g_printerr("Could not write trace to %s: %s\n", path.c_str(), error->message);
+        g_error_free(error);
+        return false;
+    }
+    return true;
+}
+
+// "name 12.3 ms" for the overlay.
+static std::string format_trace_event(const TraceEvent &ev) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), " %.1f ms", static_cast<double>(ev.dur_us) / 1000.0);
+    return ev.name + std::string(buf);
 }
 
-// Just run a command, return true if exit status == 0, keep GTK responsive.
-bool run_command_status(const std::string &cmd) {
-    FILE *pipe = popen(cmd.c_str(), "r");
-    if (!pipe) return false;
+// ───────────────────────────────────────────────
+//  Child processes
+// ───────────────────────────────────────────────
+
+// Commands are spawned directly from an argv (no /bin/sh in between) and
+// their pipes are watched from the GTK main loop, so nothing ever blocks
+// waiting for output. Output is handed to the callbacks chunk by chunk,
+// as soon as it arrives.
+using ChunkCallback = std::function<void(const char *data, size_t len)>;
+
+struct ProcessCallbacks {
+    ChunkCallback on_stdout;   // optional
+    ChunkCallback on_stderr;   // optional
+    // Called once, after the child exited and both pipes hit EOF.
+    // `ok` is true for exit status 0.
+    std::function<void(bool ok)> on_exit;
+};
+
+struct Process {
+    GPid pid = 0;
+    int out_fd = -1;
+    int err_fd = -1;
+    bool exited = false;
+    bool finished = false;
+    int wait_status = 0;
+    ProcessCallbacks callbacks;
+    gint64 trace_start_us = 0;
+    std::string trace_detail;   // the command line, when tracing
+    // Keeps the process object alive until on_exit has run.
+    std::shared_ptr<Process> self;
+};
+using ProcessPtr = std::shared_ptr<Process>;
+
+static const size_t PROCESS_READ_CHUNK = 64 * 1024;
 
-    char buffer[4096];
-    while (fgets(buffer, sizeof(buffer), pipe)) {
-        // If you ever want to log, process `buffer` here.
+static void process_maybe_finish(Process *proc) {
+    if (proc->finished || !proc->exited || proc->out_fd >= 0 || proc->err_fd >= 0) {
+        return;
+    }
+    proc->finished = true;
+
+    bool ok = WIFEXITED(proc->wait_status) && WEXITSTATUS(proc->wait_status) == 0;
+    ProcessPtr keep = std::move(proc->self);
+    trace_record("process", proc->trace_start_us, std::move(proc->trace_detail));
+    if (proc->callbacks.on_exit) proc->callbacks.on_exit(ok);
+}
 
-        // Keep GTK responsive while the command runs
-        while (gtk_events_pending()) {
-            gtk_main_iteration_do(FALSE);
+// Drain whatever is readable right now. Returns false once the pipe is closed.
+static bool process_drain_fd(int fd, const ChunkCallback &sink) {
+    static char buffer[PROCESS_READ_CHUNK];
+
+    // Bounded so one chatty child cannot starve the main loop.
+    for (int round = 0; round < 16; round++) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            if (sink) sink(buffer, static_cast<size_t>(n));
+            continue;
         }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+        return false; // EOF or hard error
     }
+    return true;
+}
 
-    int rc = pclose(pipe);
-    return (rc == 0);
+static gboolean on_process_stdout(gint fd, GIOCondition, gpointer data) {
+    auto *proc = static_cast<Process *>(data);
+    if (process_drain_fd(fd, proc->callbacks.on_stdout)) {
+        return G_SOURCE_CONTINUE;
+    }
+    close(fd);
+    proc->out_fd = -1;
+    process_maybe_finish(proc);
+    return G_SOURCE_REMOVE;
 }
 
-// Strip ANSI color (CSI) and OSC hyperlink sequences from yay output.
-std::string strip_ansi_and_osc(const std::string &input) {
-    std::string out;
-    out.reserve(input.size());
+static gboolean on_process_stderr(gint fd, GIOCondition, gpointer data) {
+    auto *proc = static_cast<Process *>(data);
+    if (process_drain_fd(fd, proc->callbacks.on_stderr)) {
+        return G_SOURCE_CONTINUE;
+    }
+    close(fd);
+    proc->err_fd = -1;
+    process_maybe_finish(proc);
+    return G_SOURCE_REMOVE;
+}
 
-    size_t i = 0;
-    while (i < input.size()) {
-        unsigned char c = static_cast<unsigned char>(input[i]);
+static void on_process_exited(GPid pid, gint wait_status, gpointer data) {
+    auto *proc = static_cast<Process *>(data);
+    g_spawn_close_pid(pid);
+    proc->exited = true;
+    proc->wait_status = wait_status;
+    process_maybe_finish(proc);
+}
 
-        if (c == 0x1B) { // ESC
-            if (i + 1 >= input.size()) {
-                // Lone ESC at end, skip it.
-                i++;
-                continue;
-            }
+static gboolean report_spawn_failure(gpointer data) {
+    process_maybe_finish(static_cast<Process *>(data));
+    return G_SOURCE_REMOVE;
+}
 
-            unsigned char next = static_cast<unsigned char>(input[i + 1]);
+// Spawn `argv` (looked up in $PATH). If `stdin_data` is given it is written
+// to the child's stdin, which is then closed; otherwise stdin is inherited.
+// `working_dir` and `envp` (a full environment, see g_get_environ) default
+// to ours. Main thread only. on_exit always fires, even when spawning fails.
+ProcessPtr spawn_process(const std::vector<std::string> &argv,
+                         ProcessCallbacks callbacks,
+                         const std::string *stdin_data = nullptr,
+                         const char *working_dir = nullptr,
+                         gchar **envp = nullptr) {
+    auto proc = std::make_shared<Process>();
+    proc->callbacks = std::move(callbacks);
+    proc->self = proc;
+    proc->trace_start_us = trace_start();
+    if (proc->trace_start_us) {
+        for (const auto &arg : argv) {
+            if (proc->trace_detail.size() > 200) break;
+            if (!proc->trace_detail.empty()) proc->trace_detail += ' ';
+            proc->trace_detail += arg;
+        }
+    }
 
-            // CSI sequences: ESC [
-            if (next == '[') {
-                size_t j = i + 2;
-                while (j < input.size()) {
-                    unsigned char d = static_cast<unsigned char>(input[j]);
-                    // Final byte in CSI sequence is between '@' and '~'
-                    if (d >= '@' && d <= '~') {
-                        j++;
-                        break;
-                    }
-                    j++;
-                }
-                i = j;
-                continue;
-            }
+    std::vector<gchar *> c_argv;
+    for (const auto &arg : argv) c_argv.push_back(const_cast<gchar *>(arg.c_str()));
+    c_argv.push_back(nullptr);
+
+    gint in_fd = -1;
+    GError *error = nullptr;
+    gboolean spawned = g_spawn_async_with_pipes(
+        working_dir, c_argv.data(), envp,
+        static_cast<GSpawnFlags>(G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD),
+        nullptr, nullptr,
+        &proc->pid,
+        stdin_data ? &in_fd : nullptr,
+        &proc->out_fd,
+        &proc->err_fd,
+        &error);
+
+    if (!spawned) {
+        g_printerr("Failed to run %s: %s\n", argv.empty() ? "?" : argv[0].c_str(),
+                   error ? error->message : "unknown error");
+        g_clear_error(&error);
+        proc->out_fd = proc->err_fd = -1;
+        proc->exited = true;
+        proc->wait_status = -1;
+        // Report asynchronously so callers see the same ordering either way.
+        g_idle_add(report_spawn_failure, proc.get());
+        return proc;
+    }
 
-            // OSC sequences: ESC ]
-            if (next == ']') {
-                size_t j = i + 2;
-                while (j < input.size()) {
-                    unsigned char d = static_cast<unsigned char>(input[j]);
-                    if (d == 0x07) { // BEL terminator
-                        j++;
-                        break;
-                    }
-                    // String terminator: ESC followed by backslash
-                    if (d == 0x1B && j + 1 < input.size() &&
-                        static_cast<unsigned char>(input[j + 1]) == '\\') {
-                        j += 2;
-                        break;
-                    }
+    if (stdin_data) {
+        // Small payloads only (a password line); fits in the pipe buffer.
+        const char *p = stdin_data->data();
+        size_t left = stdin_data->size();
+        while (left > 0) {
+            ssize_t n = write(in_fd, p, left);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            p += n;
+            left -= static_cast<size_t>(n);
+        }
+        close(in_fd);
+    }
+
+    g_unix_set_fd_nonblocking(proc->out_fd, TRUE, nullptr);
+    g_unix_set_fd_nonblocking(proc->err_fd, TRUE, nullptr);
+    g_unix_fd_add(proc->out_fd, static_cast<GIOCondition>(G_IO_IN | G_IO_HUP | G_IO_ERR),
+                  on_process_stdout, proc.get());
+    g_unix_fd_add(proc->err_fd, static_cast<GIOCondition>(G_IO_IN | G_IO_HUP | G_IO_ERR),
+                  on_process_stderr, proc.get());
+    g_child_watch_add(proc->pid, on_process_exited, proc.get());
+
+    return proc;
+}
+
+// Ask a running child to stop. Its remaining output is dropped and
+// on_exit still fires (with ok == false) once it is gone. Not to be called
+// from the child's own on_stdout / on_stderr.
+void terminate_process(const ProcessPtr &proc) {
+    if (!proc || proc->exited || proc->pid <= 0) return;
+    kill(proc->pid, SIGTERM);
+    // The pipes are still drained until EOF, just into nothing.
+    proc->callbacks.on_stdout = nullptr;
+    proc->callbacks.on_stderr = nullptr;
+}
+
+// One child's stdout or stderr on its way into the command log: the line
+// it is in the middle of, the tag its lines carry, and the transaction log
+// file (CommandLog::file_id) they also go to, 0 for none.
+struct LogStream {
+    std::string tag;
+    unsigned file_id = 0;
+    std::string partial;
+    ~LogStream();   // logs an unterminated last line
+};
+
+static void command_log_output(LogStream &stream, const char *data, size_t len);
+static unsigned command_log_file_id();
+
+static ChunkCallback forward_output(FILE *to, std::string tag, bool transaction) {
+    auto stream = std::make_shared<LogStream>();
+    stream->tag = std::move(tag);
+    stream->file_id = transaction ? command_log_file_id() : 0;
+    return [to, stream](const char *data, size_t len) {
+        fwrite(data, 1, len, to);
+        fflush(to);
+        command_log_output(*stream, data, len);
+    };
+}
+
+// Pass a child's output through to our own stdout/stderr, and to the
+// command log pane (see CommandLog) with each line tagged `tag`. Output of
+// the running transaction's own processes (`transaction`) also goes to its
+// log file.
+static ChunkCallback forward_to_stdout(std::string tag, bool transaction = false) {
+    return forward_output(stdout, std::move(tag), transaction);
+}
+
+static ChunkCallback forward_to_stderr(std::string tag, bool transaction = false) {
+    return forward_output(stderr, std::move(tag), transaction);
+}
+
+// Finding escape sequences quickly: yay output is mostly plain text, so
+// both the stripper below and the search parser skip over clean spans in
+// bulk instead of looking at every byte. For the single ESC byte glibc's
+// memchr is already vectorized; ESC-or-newline (what the line parser
+// needs) gets SSE2/AVX2 versions, picked once at runtime.
+static const char *scan_esc_or_newline_scalar(const char *p, const char *end) {
+    for (; p < end; p++) {
+        if (*p == 0x1B || *p == '\n') return p;
+    }
+    return end;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+static const char *scan_esc_or_newline_sse2(const char *p, const char *end) {
+    const __m128i esc = _mm_set1_epi8(0x1B);
+    const __m128i nl = _mm_set1_epi8('\n');
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, esc), _mm_cmpeq_epi8(v, nl)));
+        if (mask) return p + __builtin_ctz(static_cast<unsigned>(mask));
+    }
+    return scan_esc_or_newline_scalar(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char *scan_esc_or_newline_avx2(const char *p, const char *end) {
+    const __m256i esc = _mm256_set1_epi8(0x1B);
+    const __m256i nl = _mm256_set1_epi8('\n');
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, esc), _mm256_cmpeq_epi8(v, nl))));
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return scan_esc_or_newline_sse2(p, end);
+}
+#endif
+
+using ScanFn = const char *(*)(const char *p, const char *end);
+
+static ScanFn pick_esc_or_newline_scan() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return scan_esc_or_newline_avx2;
+    if (__builtin_cpu_supports("sse2")) return scan_esc_or_newline_sse2;
+#endif
+    return scan_esc_or_newline_scalar;
+}
+
+// First ESC or '\n' in [p, end), or `end` if there is none.
+static inline const char *scan_esc_or_newline(const char *p, const char *end) {
+    static const ScanFn scan = pick_esc_or_newline_scan();
+    return scan(p, end);
+}
+
+// Strip ANSI color (CSI) and OSC hyperlink sequences from `buf` in place.
+// Returns the new length. Clean spans between escapes are moved with one
+// memmove each; text without any ESC is left untouched.
+size_t strip_ansi_and_osc_inplace(char *buf, size_t len) {
+    TraceScope trace("strip_ansi_and_osc");
+    char *const end = buf + len;
+    char *in = static_cast<char *>(memchr(buf, 0x1B, len));
+    if (!in) return len;
+    char *out = in;
+
+    while (in < end) {
+        // `in` is at an ESC.
+        if (in + 1 >= end) {
+            // Lone ESC at end, skip it.
+            in++;
+        } else if (in[1] == '[') {
+            // CSI sequences: ESC [ ... final byte between '@' and '~'
+            char *j = in + 2;
+            while (j < end && !(*j >= '@' && *j <= '~')) j++;
+            in = j < end ? j + 1 : end;
+        } else if (in[1] == ']') {
+            // OSC sequences: ESC ] ... terminated by BEL or ESC backslash
+            char *j = in + 2;
+            while (j < end) {
+                if (*j == 0x07) {
                     j++;
+                    break;
                 }
-                i = j;
-                continue;
+                if (*j == 0x1B && j + 1 < end && j[1] == '\\') {
+                    j += 2;
+                    break;
+                }
+                j++;
             }
-
+            in = j;
+        } else {
             // Any other ESC sequence: just drop the ESC and move on.
-            i++;
-            continue;
+            in++;
         }
 
-        // Normal character, keep it.
-        out.push_back(input[i]);
-        i++;
+        char *next = in < end ? static_cast<char *>(memchr(in, 0x1B, static_cast<size_t>(end - in)))
+                              : nullptr;
+        size_t span = static_cast<size_t>((next ? next : end) - in);
+        memmove(out, in, span);
+        out += span;
+        in += span;
     }
+    return static_cast<size_t>(out - buf);
+}
 
-    return out;
+std::string strip_ansi_and_osc(std::string input) {
+    input.resize(strip_ansi_and_osc_inplace(&input[0], input.size()));
+    return input;
 }
 
 // Run a sudo command with password sent on stdin (no output captured).
 // We use this to pre-auth sudo (not to run yay itself).
-bool run_sudo_with_password(const std::string &password,
-                            const std::string &cmd) {
-    if (password.empty()) return false;
+void run_sudo_with_password(const std::string &password,
+                            const std::vector<std::string> &argv,
+                            std::function<void(bool ok)> on_done) {
+    if (password.empty()) {
+        on_done(false);
+        return;
+    }
 
-    FILE *pipe = popen(cmd.c_str(), "w");
-    if (!pipe) return false;
+    ProcessCallbacks callbacks;
+    callbacks.on_stderr = forward_to_stderr("sudo", true);
+    callbacks.on_exit = std::move(on_done);
 
     std::string pwline = password + "\n";
-    fwrite(pwline.c_str(), 1, pwline.size(), pipe);
-    fflush(pipe);
+    spawn_process(argv, std::move(callbacks), &pwline);
+}
+
+// yay (and our own build steps) run sudo themselves and rely on sudo's
+// cached credentials. An operation re-validates unless the last successful
+// `sudo -v` is younger than SUDO_KEEPALIVE_SECONDS, and while operations
+// are queued or running a timer refreshes the timestamp at that interval,
+// well inside sudo's default 5 minute timeout; once the queue is empty it
+// stops. Ages are measured on CLOCK_BOOTTIME, which keeps counting through
+// suspend, as sudo's own timestamps do. While the timestamp is valid
+// `sudo -v` only touches it; the password is sent along anyway so an
+// expired one is simply re-authenticated.
+static const guint SUDO_KEEPALIVE_SECONDS = 60;
+
+static bool g_sudo_session_valid = false;
+static gint64 g_sudo_validated_us = 0;   // boot_time_us() of the last success
+static bool g_sudo_refreshing = false;
+static guint g_sudo_keepalive_id = 0;
+static std::string g_sudo_session_password;
+
+static bool transactions_busy();
+
+static gint64 boot_time_us() {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_BOOTTIME, &ts) != 0) return g_get_monotonic_time();
+    return static_cast<gint64>(ts.tv_sec) * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+static bool sudo_session_fresh() {
+    return g_sudo_session_valid &&
+           boot_time_us() - g_sudo_validated_us < gint64(SUDO_KEEPALIVE_SECONDS) * G_USEC_PER_SEC;
+}
+
+static gboolean refresh_sudo_session(gpointer) {
+    if (!transactions_busy()) {
+        g_sudo_keepalive_id = 0;
+        return G_SOURCE_REMOVE;
+    }
+    if (g_sudo_refreshing) return G_SOURCE_CONTINUE;
+    g_sudo_refreshing = true;
+    run_sudo_with_password(g_sudo_session_password, { "sudo", "-S", "-v" }, [](bool ok) {
+        g_sudo_refreshing = false;
+        // Next operation authenticates again (and reports failure if it must).
+        if (ok) g_sudo_validated_us = boot_time_us();
+        else g_sudo_session_valid = false;
+    });
+    return G_SOURCE_CONTINUE;
+}
 
-    int rc = pclose(pipe);
-    return (rc == 0);
+static void start_sudo_keepalive() {
+    if (!g_sudo_keepalive_id) {
+        g_sudo_keepalive_id = g_timeout_add_seconds(SUDO_KEEPALIVE_SECONDS,
+                                                    refresh_sudo_session, nullptr);
+    }
 }
 
-// Check if a package is installed using pacman.
-bool is_package_installed(const std::string &name) {
-    std::string cmd = "pacman -Qi " + name + " >/dev/null 2>&1";
-    return run_command_status(cmd);
+// Make sure sudo has cached credentials; `on_done(ok)` runs once they are
+// (synchronously when they were validated recently).
+void ensure_sudo_session(const std::string &password, std::function<void(bool ok)> on_done) {
+    if (sudo_session_fresh() && password == g_sudo_session_password) {
+        start_sudo_keepalive();
+        on_done(true);
+        return;
+    }
+
+    run_sudo_with_password(password, { "sudo", "-S", "-v" },
+                           [password, on_done = std::move(on_done)](bool ok) {
+        g_sudo_session_valid = ok;
+        if (ok) {
+            g_sudo_validated_us = boot_time_us();
+            g_sudo_session_password = password;
+            start_sudo_keepalive();
+        }
+        on_done(ok);
+    });
 }
 
 // ───────────────────────────────────────────────
-//  Data model
+//  Command log
 // ───────────────────────────────────────────────
 
-struct PackageInfo {
-    std::string repo;
-    std::string name;
-    std::string version;
-    std::string description;
-    bool installed = false;
-};
+// Everything our child processes print (yay, makepkg, git, pacman, ...),
+// colour codes stripped, for the collapsible log pane under the results.
+// The pane holds the last COMMAND_LOG_MAX_LINES lines; output is queued and
+// goes into the text buffer once per frame, so a build printing thousands
+// of chunks a second costs one buffer update per frame. Each child's lines
+// are assembled separately and tagged with where they came from, so
+// parallel builds and clones don't splice into each other. While a
+// transaction runs, its own processes' output is also written to a file
+// under $XDG_STATE_HOME/colossus-pkgcenter/logs for later review.
+static const size_t COMMAND_LOG_MAX_LINES = 50000;
+static const size_t COMMAND_LOG_FILES_KEPT = 20;
+static const size_t COMMAND_LOG_MAX_PARTIAL = 64 * 1024;  // a "line" that never ends
+
+class CommandLog {
+public:
+    // A chunk of one child's stdout or stderr.
+    void append(LogStream &stream, const char *data, size_t len) {
+        std::string &partial = stream.partial;
+        const char *end = data + len;
+        while (data < end) {
+            const char *nl = static_cast<const char *>(memchr(data, '\n', static_cast<size_t>(end - data)));
+            partial.append(data, static_cast<size_t>((nl ? nl : end) - data));
+            if (!nl) break;
+            add_line(partial, stream);
+            partial.clear();
+            data = nl + 1;
+        }
+        if (partial.size() > COMMAND_LOG_MAX_PARTIAL) {
+            add_line(partial, stream);
+            partial.clear();
+        }
+        // Progress bars redraw with '\r' and may never end a line; only
+        // their latest state matters.
+        size_t cr = partial.rfind('\r');
+        if (cr != std::string::npos && cr + 1 < partial.size()) partial.erase(0, cr + 1);
+    }
 
-// Parse `yay -Ss` output (after stripping ANSI/OSC)
-std::vector<PackageInfo> parse_yay_search(const std::string &output) {
-    std::vector<PackageInfo> pkgs;
+    // The child is gone; log what it printed after its last newline.
+    void finish(LogStream &stream) {
+        if (!stream.partial.empty()) add_line(std::move(stream.partial), stream);
+        stream.partial.clear();
+    }
 
-    std::istringstream iss(output);
-    std::string line;
-    PackageInfo current;
-    bool expecting_desc = false;
+    // Copy lines to a new log file until end_file(). Returns its path, or
+    // an empty string if it cannot be created (the pane still works).
+    std::string begin_file(const std::string &title) {
+        if (file_) end_file(false);
+
+        gchar *dir = g_build_filename(g_get_user_state_dir(), "colossus-pkgcenter", "logs", nullptr);
+        std::string dir_path(dir);
+        g_free(dir);
+        if (g_mkdir_with_parents(dir_path.c_str(), 0700) != 0) return std::string();
+        prune_files(dir_path);
+
+        GDateTime *now = g_date_time_new_now_local();
+        gchar *stamp = g_date_time_format(now, "%Y%m%d-%H%M%S");
+        gchar *header = g_date_time_format(now, "%F %T");
+        g_date_time_unref(now);
+        file_path_ = dir_path + "/" + stamp + ".log";
+        g_free(stamp);
+
+        file_ = fopen(file_path_.c_str(), "a");
+        if (!file_) file_path_.clear();
+        file_id_++;
+        add_line(std::string("==> ") + header + "  " + title);
+        g_free(header);
+        return file_path_;
+    }
 
-    while (std::getline(iss, line)) {
-        if (line.empty()) {
-            expecting_desc = false;
-            continue;
+    void end_file(bool ok) {
+        if (!file_) return;
+        add_line(ok ? "==> Finished" : "==> Failed");
+        fclose(file_);
+        file_ = nullptr;
+    }
+
+    // The file of the current or most recent transaction, if any.
+    const std::string &file_path() const { return file_path_; }
+
+    // Identifies the open file (for LogStream::file_id); 0 when none is.
+    unsigned file_id() const { return file_ ? file_id_ : 0; }
+
+    void attach(GtkTextView *view) {
+        view_ = view;
+        GtkTextBuffer *buffer = gtk_text_view_get_buffer(view_);
+        GtkTextIter end;
+        gtk_text_buffer_get_end_iter(buffer, &end);
+        end_mark_ = gtk_text_buffer_create_mark(buffer, nullptr, &end, FALSE);
+        unflushed_ = lines_.size();
+        dropped_ = 0;
+        // Output that came in while the pane was collapsed shows up on expand.
+        g_signal_connect_swapped(view_, "map", G_CALLBACK(on_map), this);
+        schedule_flush();
+    }
+
+private:
+    void add_line(std::string line, const LogStream &stream) {
+        add_line(std::move(line), stream.tag, stream.file_id);
+    }
+
+    // Our own lines (file headers) carry no tag and go to the open file.
+    void add_line(std::string line) { add_line(std::move(line), std::string(), file_id()); }
+
+    void add_line(std::string line, const std::string &tag, unsigned file_id) {
+        if (!line.empty() && line.back() == '\r') line.pop_back(); // CRLF
+        size_t cr = line.rfind('\r');
+        if (cr != std::string::npos) line.erase(0, cr + 1);
+        line = strip_ansi_and_osc(std::move(line));
+        if (!g_utf8_validate(line.c_str(), static_cast<gssize>(line.size()), nullptr)) {
+            gchar *valid = g_utf8_make_valid(line.c_str(), static_cast<gssize>(line.size()));
+            line = valid;
+            g_free(valid);
         }
 
-        // Description lines: leading space or tab
-        if (!line.empty() && (line[0] == ' ' || line[0] == '\t')) {
-            if (expecting_desc) {
-                size_t pos = line.find_first_not_of(" \t");
-                if (pos != std::string::npos) {
-                    current.description = line.substr(pos);
-                } else {
-                    current.description = line;
-                }
-                pkgs.push_back(current);
-                expecting_desc = false;
-            }
-            continue;
+        if (!tag.empty()) line = "[" + tag + "] " + line;
+
+        if (file_ && file_id == file_id_) {
+            fwrite(line.data(), 1, line.size(), file_);
+            fputc('\n', file_);
         }
 
-        // Header line: "repo/name version [installed]"
-        std::istringstream header(line);
-        std::string repo_name, version;
-        if (!(header >> repo_name >> version)) {
-            continue;
+        lines_.push_back(std::move(line));
+        unflushed_++;
+        if (lines_.size() > COMMAND_LOG_MAX_LINES) {
+            lines_.pop_front();
+            if (unflushed_ > lines_.size()) unflushed_ = lines_.size();
+            else dropped_++;
         }
+        schedule_flush();
+    }
 
-        size_t slash_pos = repo_name.find('/');
-        if (slash_pos == std::string::npos) {
-            continue;
+    void schedule_flush() {
+        if (!view_ || tick_id_ || (unflushed_ == 0 && dropped_ == 0)) return;
+        tick_id_ = gtk_widget_add_tick_callback(GTK_WIDGET(view_), on_tick, this, nullptr);
+    }
+
+    static gboolean on_tick(GtkWidget *, GdkFrameClock *, gpointer self) {
+        auto *log = static_cast<CommandLog *>(self);
+        log->tick_id_ = 0;
+        log->flush();
+        return G_SOURCE_REMOVE;
+    }
+
+    static void on_map(CommandLog *self) { self->flush(); }
+
+    // Bring the text buffer in line with lines_: drop what fell out of the
+    // ring at the top, add what is new at the bottom, in one go each.
+    void flush() {
+        if (unflushed_ == 0 && dropped_ == 0) return;
+        if (!gtk_widget_get_mapped(GTK_WIDGET(view_))) return; // on_map catches up
+        TraceScope trace("log flush", std::to_string(unflushed_) + " lines");
+
+        GtkTextBuffer *buffer = gtk_text_view_get_buffer(view_);
+        GtkAdjustment *vadj = gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(view_));
+        bool at_bottom = !vadj || gtk_adjustment_get_value(vadj) + gtk_adjustment_get_page_size(vadj) >=
+                                  gtk_adjustment_get_upper(vadj) - 1;
+
+        GtkTextIter start, end;
+        if (dropped_ > 0) {
+            gtk_text_buffer_get_start_iter(buffer, &start);
+            gtk_text_buffer_get_iter_at_line(buffer, &end, static_cast<gint>(dropped_));
+            gtk_text_buffer_delete(buffer, &start, &end);
         }
 
-        current.repo = repo_name.substr(0, slash_pos);
-        current.name = repo_name.substr(slash_pos + 1);
-        current.version = version;
-        current.description.clear();
-        current.installed = false;
+        std::string text;
+        for (size_t i = lines_.size() - unflushed_; i < lines_.size(); i++) {
+            text += lines_[i];
+            text.push_back('\n');
+        }
+        gtk_text_buffer_get_end_iter(buffer, &end);
+        gtk_text_buffer_insert(buffer, &end, text.data(), static_cast<gint>(text.size()));
+        unflushed_ = 0;
+        dropped_ = 0;
+
+        if (at_bottom) {
+            gtk_text_buffer_get_end_iter(buffer, &end);
+            gtk_text_buffer_move_mark(buffer, end_mark_, &end);
+            gtk_text_view_scroll_mark_onscreen(view_, end_mark_);
+        }
+    }
 
-        std::string rest;
-        std::getline(header, rest);
-        if (rest.find("[installed]") != std::string::npos ||
-            rest.find("(installed)") != std::string::npos) {
-            current.installed = true;
+    // Keep the newest COMMAND_LOG_FILES_KEPT - 1 files, making room for one more.
+    static void prune_files(const std::string &dir_path) {
+        std::vector<std::string> files;
+        GDir *dir = g_dir_open(dir_path.c_str(), 0, nullptr);
+        if (!dir) return;
+        const gchar *entry;
+        while ((entry = g_dir_read_name(dir)) != nullptr) {
+            if (g_str_has_suffix(entry, ".log")) files.push_back(entry);
         }
+        g_dir_close(dir);
 
-        expecting_desc = true;
+        std::sort(files.begin(), files.end());   // timestamped names: oldest first
+        while (files.size() >= COMMAND_LOG_FILES_KEPT) {
+            g_unlink((dir_path + "/" + files.front()).c_str());
+            files.erase(files.begin());
+        }
     }
 
-    return pkgs;
+    std::deque<std::string> lines_;
+    unsigned file_id_ = 0;   // bumped by every begin_file()
+    size_t unflushed_ = 0;   // newest lines not in the text buffer yet
+    size_t dropped_ = 0;     // oldest buffer lines no longer in lines_
+    GtkTextView *view_ = nullptr;
+    GtkTextMark *end_mark_ = nullptr;
+    guint tick_id_ = 0;
+    FILE *file_ = nullptr;
+    std::string file_path_;
+};
+
+static CommandLog g_command_log;
+static GtkWidget *g_log_expander = nullptr;
+
+static void command_log_output(LogStream &stream, const char *data, size_t len) {
+    g_command_log.append(stream, data, len);
 }
 
-// ───────────────────────────────────────────────
-//  Globals
-// ───────────────────────────────────────────────
+static unsigned command_log_file_id() { return g_command_log.file_id(); }
 
-static GtkWidget *g_main_window   = nullptr;
-static GtkWidget *g_search_entry  = nullptr;
-static GtkWidget *g_results_list  = nullptr;
-static GtkWidget *g_status_label  = nullptr;
-static std::string g_sudo_password;
+LogStream::~LogStream() { g_command_log.finish(*this); }
 
-// Forward declarations
-static void perform_search(const std::string &query);
-extern "C" void on_install_clicked(GtkWidget *button, gpointer user_data);
-extern "C" void on_remove_clicked(GtkWidget *button, gpointer user_data);
-extern "C" void on_clean_orphans_clicked(GtkWidget *button, gpointer user_data);
+// For a failure dialog: open the pane and say where the full log is.
+static void show_log_hint(GtkWidget *dialog) {
+    if (g_log_expander) gtk_expander_set_expanded(GTK_EXPANDER(g_log_expander), TRUE);
+    const std::string &path = g_command_log.file_path();
+    if (!path.empty()) {
+        gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog),
+                                                 "Full log: %s", path.c_str());
+    }
+}
+
+GtkWidget *create_log_pane() {
+    GtkWidget *view = gtk_text_view_new();
+    gtk_text_view_set_editable(GTK_TEXT_VIEW(view), FALSE);
+    gtk_text_view_set_cursor_visible(GTK_TEXT_VIEW(view), FALSE);
+    gtk_text_view_set_monospace(GTK_TEXT_VIEW(view), TRUE);
+    gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(view), GTK_WRAP_CHAR);
+    gtk_text_view_set_left_margin(GTK_TEXT_VIEW(view), 6);
+
+    GtkWidget *scroll = gtk_scrolled_window_new(nullptr, nullptr);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll),
+                                   GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    gtk_widget_set_size_request(scroll, -1, 180);
+    gtk_container_add(GTK_CONTAINER(scroll), view);
+
+    g_log_expander = gtk_expander_new("Command log");
+    gtk_widget_set_margin_start(g_log_expander, 6);
+    gtk_widget_set_margin_end(g_log_expander, 6);
+    gtk_container_add(GTK_CONTAINER(g_log_expander), scroll);
+
+    g_command_log.attach(GTK_TEXT_VIEW(view));
+    return g_log_expander;
+}
 
 // ───────────────────────────────────────────────
-//  Install / Remove / Clean handlers
+//  Background jobs
 // ───────────────────────────────────────────────
 
-extern "C" void on_install_clicked(GtkWidget *button, gpointer user_data) {
-    (void)button;
-    char *pkg_name_c = static_cast<char *>(user_data);
-    if (!pkg_name_c) return;
+// Hand a closure to the GTK main thread. Worker threads must never touch
+// widgets directly; they report back through this instead.
+static gboolean main_thread_trampoline(gpointer data) {
+    auto *fn = static_cast<std::function<void()> *>(data);
+    (*fn)();
+    delete fn;
+    return G_SOURCE_REMOVE;
+}
 
-    std::string pkg_name(pkg_name_c);
-    g_free(pkg_name_c);
+void run_on_main_thread(std::function<void()> fn) {
+    g_idle_add(main_thread_trampoline, new std::function<void()>(std::move(fn)));
+}
 
-    if (g_sudo_password.empty()) {
-        GtkWidget *warn = gtk_message_dialog_new(
-            GTK_WINDOW(g_main_window),
-            GTK_DIALOG_MODAL,
-            GTK_MESSAGE_ERROR,
-            GTK_BUTTONS_OK,
-            "No sudo password cached.\nPlease restart the app."
-        );
-        gtk_dialog_run(GTK_DIALOG(warn));
-        gtk_widget_destroy(warn);
-        return;
+// One unit of background work. `work` runs on the queue's thread,
+// `finished` runs afterwards on the main thread (also when cancelled, so
+// callers can tear down their UI; check `cancelled` before using results).
+struct Job {
+    std::atomic<bool> cancelled{false};
+    std::function<void(Job &)> work;
+    std::function<void(Job &)> finished;
+};
+using JobPtr = std::shared_ptr<Job>;
+
+// A FIFO of jobs drained by a single worker thread. Each queue is a lane:
+// jobs on the same lane never overlap, so heavy work (index builds, AUR
+// requests) is serialized without blocking the UI. Transactions are not
+// jobs; see OperationQueue.
+class JobQueue {
+public:
+    JobQueue() : thread_([this] { loop(); }) {}
+
+    // Nothing is allowed to finish: queued jobs are dropped, the running
+    // one is flagged cancelled and waited for until its `work` returns
+    // (sooner if it checks the flag). No `finished` callbacks run.
+    ~JobQueue() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+            for (auto &job : pending_) job->cancelled = true;
+            if (current_) current_->cancelled = true;
+        }
+        cv_.notify_all();
+        thread_.join();
     }
 
-    GtkWidget *dialog = gtk_message_dialog_new(
-        GTK_WINDOW(g_main_window),
-        GTK_DIALOG_MODAL,
-        GTK_MESSAGE_QUESTION,
-        GTK_BUTTONS_OK_CANCEL,
-        "Install package \"%s\" using yay?",
-        pkg_name.c_str()
-    );
-    gint response = gtk_dialog_run(GTK_DIALOG(dialog));
-    gtk_widget_destroy(dialog);
-
-    if (response != GTK_RESPONSE_OK) {
-        return;
+    // Main thread only.
+    void submit(JobPtr job) {
+        in_flight_++;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_.push_back(std::move(job));
+        }
+        cv_.notify_one();
     }
 
-    if (g_status_label) {
-        std::string msg = "Installing " + pkg_name + "...";
-        gtk_label_set_text(GTK_LABEL(g_status_label), msg.c_str());
+    // Flag every queued and running job as cancelled. Their `finished`
+    // callbacks still run, in order.
+    void cancel_all() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &job : pending_) job->cancelled = true;
+        if (current_) current_->cancelled = true;
     }
 
-    GtkWidget *info = gtk_message_dialog_new(
-        GTK_WINDOW(g_main_window),
-        GTK_DIALOG_MODAL,
-        GTK_MESSAGE_INFO,
-        GTK_BUTTONS_NONE,
-        "Installing %s...\n\nThis may take a moment.",
-        pkg_name.c_str()
-    );
-    gtk_widget_show_all(info);
+    // True while any submitted job has not reported back yet. Main thread only.
+    bool busy() const { return in_flight_ > 0; }
 
-    // 1) Pre-authenticate sudo (cache credentials for the user).
-    bool auth_ok = run_sudo_with_password(
-        g_sudo_password,
-        "sudo -S -v"
-    );
+private:
+    void loop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            cv_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+            if (stopping_) return;
 
-    bool ok = false;
-    if (auth_ok) {
-        // 2) Run yay as the NORMAL USER (no sudo here!)
-        //    yay will call sudo pacman internally, which will reuse the cached credentials.
-        std::string cmd =
-            "yay -S --noconfirm "
-            "--answerclean None "
-            "--answerdiff None "
-            "--answeredit None "
-            + pkg_name;
+            current_ = pending_.front();
+            pending_.pop_front();
+            JobPtr job = current_;
+            lock.unlock();
 
-        ok = run_command_status(cmd);
+            if (!job->cancelled && job->work) {
+                job->work(*job);
+            }
+            run_on_main_thread([this, job] {
+                in_flight_--;
+                if (job->finished) job->finished(*job);
+            });
+
+            lock.lock();
+            current_.reset();
+        }
     }
 
-    gtk_widget_destroy(info);
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<JobPtr> pending_;
+    JobPtr current_;
+    bool stopping_ = false;
+    guint in_flight_ = 0;
+    std::thread thread_;
+};
+
+// Parsing of search output: a new query cancels whatever is still queued.
+static JobQueue *g_search_jobs = nullptr;
 
-    GtkWidget *done = gtk_message_dialog_new(
-        GTK_WINDOW(g_main_window),
-        GTK_DIALOG_MODAL,
-        ok ? GTK_MESSAGE_INFO : GTK_MESSAGE_ERROR,
-        GTK_BUTTONS_OK,
-        ok ?
-          "Installation finished.\nRe-run the search to see the updated status." :
-          "Installation may have failed.\nCheck terminal logs or run yay manually."
-    );
-    gtk_dialog_run(GTK_DIALOG(done));
-    gtk_widget_destroy(done);
+// Asynchronous operations (usually a chain of child processes) that must
+// not overlap. Everything here happens on the main thread; an operation
+// calls `done` exactly once when its last process has finished, and only
+// then does the next one start.
+class OperationQueue {
+public:
+    using Operation = std::function<void(std::function<void()> done)>;
 
-    const char *current_query = gtk_entry_get_text(GTK_ENTRY(g_search_entry));
-    if (current_query && *current_query) {
-        perform_search(current_query);
-    } else if (g_status_label) {
-        gtk_label_set_text(GTK_LABEL(g_status_label),
-                           "Ready. Enter a search term.");
+    void submit(Operation op) {
+        pending_.push_back(std::move(op));
+        if (!running_) start_next();
     }
-}
 
-extern "C" void on_remove_clicked(GtkWidget *button, gpointer user_data) {
-    (void)button;
-    char *pkg_name_c = static_cast<char *>(user_data);
-    if (!pkg_name_c) return;
+    bool busy() const { return running_ || !pending_.empty(); }
 
-    std::string pkg_name(pkg_name_c);
-    g_free(pkg_name_c);
+    // Run `fn` once nothing is queued or running any more (now, if so).
+    void when_idle(std::function<void()> fn) {
+        if (!busy()) {
+            fn();
+            return;
+        }
+        idle_.push_back(std::move(fn));
+    }
 
-    if (g_sudo_password.empty()) {
+private:
+    void start_next() {
+        if (pending_.empty()) {
+            running_ = false;
+            std::vector<std::function<void()>> idle;
+            idle.swap(idle_);
+            for (auto &fn : idle) fn();
+            return;
+        }
+        running_ = true;
+        Operation op = std::move(pending_.front());
+        pending_.pop_front();
+        op([this] { start_next(); });
+    }
+
+    std::deque<Operation> pending_;
+    std::vector<std::function<void()>> idle_;
+    bool running_ = false;
+};
+
+// Install / remove / clean: strictly one after another.
+static OperationQueue g_transactions;
+
+static bool transactions_busy() { return g_transactions.busy(); }
+
+// Run fn(i) for every i in [0, n) on up to `threads` threads, the calling
+// one included, and return once all are done. For fanning a job's work out
+// (e.g. stat() over thousands of files), not for anything touching GTK.
+static void parallel_for(size_t n, size_t threads, const std::function<void(size_t)> &fn) {
+    threads = std::max<size_t>(1, std::min(threads, n));
+    std::atomic<size_t> next{ 0 };
+    auto worker = [&] {
+        for (size_t i = next.fetch_add(1); i < n; i = next.fetch_add(1)) fn(i);
+    };
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < threads; t++) pool.emplace_back(worker);
+    worker();
+    for (auto &t : pool) t.join();
+}
+
+// ───────────────────────────────────────────────
+//  libalpm backend (optional)
+// ───────────────────────────────────────────────
+
+// Built with COLOSSUS_WITH_ALPM (see the Makefile), repo queries go
+// through libalpm in-process instead of pacman/yay subprocesses or our own
+// DB file parsing. yay is still used for everything AUR.
+#ifdef COLOSSUS_WITH_ALPM
+
+static const char *PACMAN_ROOT   = "/";
+static const char *PACMAN_DBPATH = "/var/lib/pacman/";
+
+// A fresh read-only handle. Handles are not thread-safe, so every caller
+// (main thread or a job) opens its own and releases it when done.
+static alpm_handle_t *open_alpm_handle(const char *dbpath = PACMAN_DBPATH) {
+    alpm_errno_t err = ALPM_ERR_OK;
+    alpm_handle_t *handle = alpm_initialize(PACMAN_ROOT, dbpath, &err);
+    if (!handle) {
+        g_printerr("libalpm: %s\n", alpm_strerror(err));
+    }
+    return handle;
+}
+
+// Name and version of every installed package, straight from the local DB.
+static bool alpm_list_installed(std::unordered_map<std::string, std::string> &out) {
+    alpm_handle_t *handle = open_alpm_handle();
+    if (!handle) return false;
+
+    alpm_db_t *local = alpm_get_localdb(handle);
+    for (alpm_list_t *it = alpm_db_get_pkgcache(local); it; it = it->next) {
+        auto *pkg = static_cast<alpm_pkg_t *>(it->data);
+        out[alpm_pkg_get_name(pkg)] = alpm_pkg_get_version(pkg);
+    }
+    alpm_release(handle);
+    return true;
+}
+
+#endif // COLOSSUS_WITH_ALPM
+
+// ───────────────────────────────────────────────
+//  Installed-package index
+// ───────────────────────────────────────────────
+
+// Every installed package (name → version), built in one go from pacman's
+// local DB instead of forking `pacman -Qi` for each search result.
+// C++17's unordered_map cannot be searched by string_view, so lookups go
+// through g_installed_lookup, keyed by views of g_installed_index's own
+// keys (nodes never move), and allocate nothing. Replace the index through
+// set_installed_index() only.
+static std::unordered_map<std::string, std::string> g_installed_index;
+static std::unordered_map<std::string_view, const std::string *> g_installed_lookup;
+static bool g_installed_index_valid = false;
+
+static void set_installed_index(std::unordered_map<std::string, std::string> index) {
+    g_installed_lookup.clear();
+    g_installed_index = std::move(index);
+    g_installed_lookup.reserve(g_installed_index.size());
+    for (const auto &kv : g_installed_index) g_installed_lookup.emplace(kv.first, &kv.second);
+    g_installed_index_valid = true;
+}
+
+static const char *PACMAN_LOCAL_DB = "/var/lib/pacman/local";
+
+// Local DB entries are directories named "<name>-<pkgver>-<pkgrel>".
+// Package names may contain '-', so split off the last two components.
+static bool split_local_db_entry(const std::string &entry, std::string &name, std::string &version) {
+    size_t rel = entry.rfind('-');
+    if (rel == std::string::npos || rel == 0) return false;
+    size_t ver = entry.rfind('-', rel - 1);
+    if (ver == std::string::npos || ver == 0) return false;
+    name = entry.substr(0, ver);
+    version = entry.substr(ver + 1);
+    return true;
+}
+
+// Name -> version of every installed package. Any thread.
+static void read_installed_index(std::unordered_map<std::string, std::string> &index) {
+#ifdef COLOSSUS_WITH_ALPM
+    if (alpm_list_installed(index)) return;
+    index.clear();
+#endif
+
+    GDir *dir = g_dir_open(PACMAN_LOCAL_DB, 0, nullptr);
+    if (dir) {
+        const gchar *entry;
+        std::string name, version;
+        while ((entry = g_dir_read_name(dir)) != nullptr) {
+            if (split_local_db_entry(entry, name, version)) {
+                index[name] = version;
+            }
+        }
+        g_dir_close(dir);
+    } else {
+        // Unusual DB location: fall back to a single pacman call.
+        gchar *out = nullptr;
+        const gchar *argv[] = { "pacman", "-Q", nullptr };
+        if (g_spawn_sync(nullptr, const_cast<gchar **>(argv), nullptr,
+                         static_cast<GSpawnFlags>(G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL),
+                         nullptr, nullptr, &out, nullptr, nullptr, nullptr) && out) {
+            std::istringstream iss(out);
+            std::string line;
+            while (std::getline(iss, line)) {
+                size_t space = line.find(' ');
+                if (space != std::string::npos) {
+                    index[line.substr(0, space)] = line.substr(space + 1);
+                }
+            }
+        }
+        g_free(out);
+    }
+}
+
+// Rebuild the index. Preloaded at startup (or built on first use) and
+// rebuilt after anything that changes what is installed.
+void refresh_installed_index() {
+    TraceScope trace("refresh_installed_index");
+    std::unordered_map<std::string, std::string> index;
+    read_installed_index(index);
+    set_installed_index(std::move(index));
+}
+
+// Check if a package is installed (O(1) lookup in the local DB index).
+bool is_package_installed(std::string_view name) {
+    if (!g_installed_index_valid) {
+        refresh_installed_index();
+    }
+    return g_installed_lookup.count(name) != 0;
+}
+
+// Installed version of `name`, or nullptr when it is not installed.
+const std::string *installed_version(std::string_view name) {
+    if (!g_installed_index_valid) {
+        refresh_installed_index();
+    }
+    auto it = g_installed_lookup.find(name);
+    return it == g_installed_lookup.end() ? nullptr : it->second;
+}
+
+// ───────────────────────────────────────────────
+//  Data model
+// ───────────────────────────────────────────────
+
+// Repo names ("core", "extra", "aur", ...) are interned once for the whole
+// process and packages refer to them by index. Interning takes a lock, but
+// lookups do not: slots are filled once and never change. They live in
+// chunks allocated as needed (and kept for the process's lifetime), so
+// every RepoId value is usable without a table that size up front.
+using RepoId = uint16_t;
+static const size_t REPO_CHUNK = 256;
+static const size_t MAX_REPOS = size_t(std::numeric_limits<RepoId>::max()) + 1;
+
+static std::atomic<std::string *> g_repo_chunks[MAX_REPOS / REPO_CHUNK];
+static std::atomic<size_t> g_repo_count{ 0 };
+static std::mutex g_repo_names_mutex;
+
+static const std::string &repo_slot(size_t id) {
+    return g_repo_chunks[id / REPO_CHUNK].load(std::memory_order_acquire)[id % REPO_CHUNK];
+}
+
+RepoId intern_repo(std::string_view name) {
+    std::lock_guard<std::mutex> lock(g_repo_names_mutex);
+    size_t count = g_repo_count.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; i++) {
+        if (repo_slot(i) == name) return static_cast<RepoId>(i);
+    }
+    if (count == MAX_REPOS) {
+        static bool reported = false;
+        if (!reported) {
+            g_printerr("More than %zu repository names; \"%.*s\" and any later ones are "
+                       "shown as \"%s\"\n", MAX_REPOS, static_cast<int>(name.size()), name.data(),
+                       repo_slot(MAX_REPOS - 1).c_str());
+            reported = true;
+        }
+        return static_cast<RepoId>(MAX_REPOS - 1);
+    }
+    std::string *chunk = g_repo_chunks[count / REPO_CHUNK].load(std::memory_order_relaxed);
+    if (!chunk) {
+        chunk = new std::string[REPO_CHUNK];
+        g_repo_chunks[count / REPO_CHUNK].store(chunk, std::memory_order_release);
+    }
+    chunk[count % REPO_CHUNK] = std::string(name);
+    g_repo_count.store(count + 1, std::memory_order_release);
+    return static_cast<RepoId>(count);
+}
+
+std::string_view repo_name(RepoId id) {
+    return id < g_repo_count.load(std::memory_order_acquire) ? std::string_view(repo_slot(id))
+                                                             : std::string_view();
+}
+
+// Append-only string storage in large blocks. Views into it stay valid for
+// as long as the arena lives; nothing is ever moved or freed on its own.
+class StringArena {
+public:
+    std::string_view store(std::string_view s) {
+        if (s.empty()) return std::string_view();
+        if (block_left_ < s.size()) {
+            size_t size = std::max(BLOCK_SIZE, s.size());
+            blocks_.push_back(std::make_unique<char[]>(size));
+            block_pos_ = blocks_.back().get();
+            block_left_ = size;
+            bytes_ += size;
+        }
+        char *dest = block_pos_;
+        memcpy(dest, s.data(), s.size());
+        block_pos_ += s.size();
+        block_left_ -= s.size();
+        return std::string_view(dest, s.size());
+    }
+
+    size_t bytes() const { return bytes_; }
+
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    char *block_pos_ = nullptr;
+    size_t block_left_ = 0;
+    size_t bytes_ = 0;
+};
+
+enum PackageFlags : uint16_t {
+    PACKAGE_INSTALLED = 1 << 0,
+    PACKAGE_UPGRADE   = 1 << 1,   // listed by the update check; version is "old → new"
+};
+
+// One package as the parser, catalog, cache and result list pass it
+// around: fixed size, no allocations. The strings are views into whatever
+// produced the package (the catalog's arena, or the StringArena a yay
+// parse filled), which the PackageList holding it keeps alive.
+struct PackageInfo {
+    std::string_view name;
+    std::string_view version;
+    std::string_view description;
+    uint32_t votes = 0;     // AUR votes, 0 for repo packages
+    RepoId repo = 0;
+    uint16_t flags = 0;
+
+    std::string_view repo_name() const { return ::repo_name(repo); }
+    bool installed() const { return (flags & PACKAGE_INSTALLED) != 0; }
+    void set_installed(bool on) {
+        flags = on ? (flags | PACKAGE_INSTALLED) : (flags & ~PACKAGE_INSTALLED);
+    }
+    bool upgrade() const { return (flags & PACKAGE_UPGRADE) != 0; }
+};
+
+// Packages plus the storage their strings point into. Copying one copies
+// the fixed-size records and bumps a few reference counts, nothing more.
+struct PackageList {
+    std::vector<PackageInfo> items;
+    std::vector<std::shared_ptr<const StringArena>> arenas; // yay output
+    std::vector<std::shared_ptr<const void>> storage;       // anything else (a catalog)
+
+    void keep_arena(const std::shared_ptr<const StringArena> &arena) {
+        if (arena && std::find(arenas.begin(), arenas.end(), arena) == arenas.end()) {
+            arenas.push_back(arena);
+        }
+    }
+
+    void keep(const std::shared_ptr<const void> &owner) {
+        if (owner && std::find(storage.begin(), storage.end(), owner) == storage.end()) {
+            storage.push_back(owner);
+        }
+    }
+
+    void keep_storage_of(const PackageList &other) {
+        for (const auto &arena : other.arenas) keep_arena(arena);
+        for (const auto &owner : other.storage) keep(owner);
+    }
+
+    void append(const PackageList &other) {
+        items.insert(items.end(), other.items.begin(), other.items.end());
+        keep_storage_of(other);
+    }
+
+    bool empty() const { return items.empty(); }
+    size_t size() const { return items.size(); }
+
+    void clear() {
+        items.clear();
+        arenas.clear();
+        storage.clear();
+    }
+};
+
+// Push-style parser for raw `yay -Ss` output. Feed it bytes in chunks of
+// any size, colour codes and all: ANSI/OSC sequences are dropped on the
+// fly, and both escape state and partial lines carry over between chunks.
+// Each package is handed to `emit` as soon as its description line ends.
+class YaySearchParser {
+public:
+    using EmitFn = std::function<void(const PackageInfo &pkg)>;
+
+    explicit YaySearchParser(EmitFn emit)
+        : emit_(std::move(emit)), arena_(std::make_shared<StringArena>()) {}
+
+    // Where the emitted packages' strings live.
+    const std::shared_ptr<StringArena> &arena() const { return arena_; }
+
+    void feed(const char *data, size_t len) {
+        const char *p = data;
+        const char *end = data + len;
+        while (p < end) {
+            if (escape_ == Escape::None) {
+                // Plain text up to the next ESC or newline, in one go.
+                const char *stop = scan_esc_or_newline(p, end);
+                line_.append(p, static_cast<size_t>(stop - p));
+                if (stop == end) break;
+                p = stop;
+            }
+            unsigned char c = static_cast<unsigned char>(*p++);
+
+            switch (escape_) {
+            case Escape::None:
+                if (c == 0x1B) { // ESC
+                    escape_ = Escape::Esc;
+                } else { // '\n'
+                    handle_line();
+                    line_.clear();
+                }
+                break;
+
+            case Escape::Esc:
+                if (c == '[') {
+                    escape_ = Escape::Csi;      // CSI sequences: ESC [
+                } else if (c == ']') {
+                    escape_ = Escape::Osc;      // OSC sequences: ESC ]
+                } else {
+                    // Any other ESC sequence: just drop the ESC and keep this byte.
+                    escape_ = Escape::None;
+                    p--;
+                }
+                break;
+
+            case Escape::Csi:
+                // Final byte in CSI sequence is between '@' and '~'
+                if (c >= '@' && c <= '~') escape_ = Escape::None;
+                break;
+
+            case Escape::Osc:
+                if (c == 0x07) {                // BEL terminator
+                    escape_ = Escape::None;
+                } else if (c == 0x1B) {
+                    escape_ = Escape::OscEsc;
+                }
+                break;
+
+            case Escape::OscEsc:
+                // String terminator: ESC followed by backslash
+                if (c == '\\') {
+                    escape_ = Escape::None;
+                } else if (c != 0x1B) {
+                    escape_ = Escape::Osc;
+                }
+                break;
+            }
+        }
+    }
+
+    // End of input: a last line without trailing newline still counts.
+    void finish() {
+        if (!line_.empty()) {
+            handle_line();
+            line_.clear();
+        }
+        escape_ = Escape::None;
+        expecting_desc_ = false;
+    }
+
+private:
+    enum class Escape { None, Esc, Csi, Osc, OscEsc };
+
+    void handle_line() {
+        const std::string &line = line_;
+
+        if (line.empty()) {
+            expecting_desc_ = false;
+            return;
+        }
+
+        // Description lines: leading space or tab
+        if (line[0] == ' ' || line[0] == '\t') {
+            if (expecting_desc_) {
+                size_t pos = line.find_first_not_of(" \t");
+                std::string_view desc(line);
+                if (pos != std::string::npos) desc.remove_prefix(pos);
+
+                PackageInfo pkg;
+                pkg.repo = current_repo_;
+                pkg.name = arena_->store(current_name_);
+                pkg.version = arena_->store(current_version_);
+                pkg.description = arena_->store(desc);
+                pkg.votes = current_votes_;
+                pkg.set_installed(current_installed_);
+                emit_(pkg);
+                expecting_desc_ = false;
+            }
+            return;
+        }
+
+        // Header line: "repo/name version [installed]"
+        std::istringstream header(line);
+        std::string repo_name, version;
+        if (!(header >> repo_name >> version)) {
+            return;
+        }
+
+        size_t slash_pos = repo_name.find('/');
+        if (slash_pos == std::string::npos) {
+            return;
+        }
+
+        current_repo_ = intern_repo(std::string_view(repo_name).substr(0, slash_pos));
+        current_name_ = repo_name.substr(slash_pos + 1);
+        current_version_ = version;
+
+        std::string rest;
+        std::getline(header, rest);
+        current_installed_ = rest.find("[installed]") != std::string::npos ||
+                             rest.find("(installed)") != std::string::npos;
+
+        // AUR entries carry "(+votes popularity)".
+        size_t votes_pos = rest.find("(+");
+        current_votes_ = votes_pos == std::string::npos
+            ? 0 : static_cast<uint32_t>(g_ascii_strtoull(rest.c_str() + votes_pos + 2, nullptr, 10));
+
+        expecting_desc_ = true;
+    }
+
+    EmitFn emit_;
+    std::shared_ptr<StringArena> arena_;
+    Escape escape_ = Escape::None;
+    std::string line_;
+    // Header of the package whose description line comes next.
+    RepoId current_repo_ = 0;
+    std::string current_name_;
+    std::string current_version_;
+    bool current_installed_ = false;
+    uint32_t current_votes_ = 0;
+    bool expecting_desc_ = false;
+};
+
+// Parse complete `yay -Ss` output in one go (ANSI/OSC codes may be present).
+PackageList parse_yay_search(const std::string &output) {
+    TraceScope trace("parse_yay_search");
+    PackageList pkgs;
+    YaySearchParser parser([&pkgs](const PackageInfo &pkg) { pkgs.items.push_back(pkg); });
+    parser.feed(output.data(), output.size());
+    parser.finish();
+    pkgs.keep_arena(parser.arena());
+    return pkgs;
+}
+
+// ───────────────────────────────────────────────
+//  Search result cache
+// ───────────────────────────────────────────────
+
+// Parsed results of recent queries, most recently used first, kept under a
+// byte budget. Installed flags are not trusted from here: they are applied
+// from the installed index whenever cached rows are shown, so transactions
+// never have to touch the cache. Anything that changes what a search
+// returns (sync DB refresh, new AUR dump) clears it.
+class SearchCache {
+public:
+    explicit SearchCache(size_t budget_bytes) : budget_(budget_bytes) {}
+
+    const PackageList *find(const std::string &key) {
+        auto it = index_.find(key);
+        if (it == index_.end()) return nullptr;
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return &it->second->pkgs;
+    }
+
+    // Counts the records and any string arena they point into; the catalog
+    // is shared with g_catalog and not charged to the cache.
+    void insert(const std::string &key, PackageList pkgs) {
+        erase(key);
+
+        size_t bytes = key.size() + sizeof(Entry) + pkgs.items.capacity() * sizeof(PackageInfo);
+        for (const auto &arena : pkgs.arenas) bytes += arena->bytes();
+        if (bytes > budget_) return; // would evict everything else
+
+        entries_.push_front(Entry{ key, std::move(pkgs), bytes });
+        index_[key] = entries_.begin();
+        used_ += bytes;
+
+        while (used_ > budget_) {
+            used_ -= entries_.back().bytes;
+            index_.erase(entries_.back().key);
+            entries_.pop_back();
+        }
+    }
+
+    void clear() {
+        entries_.clear();
+        index_.clear();
+        used_ = 0;
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        PackageList pkgs;
+        size_t bytes;
+    };
+
+    void erase(const std::string &key) {
+        auto it = index_.find(key);
+        if (it == index_.end()) return;
+        used_ -= it->second->bytes;
+        entries_.erase(it->second);
+        index_.erase(it);
+    }
+
+    size_t budget_;
+    size_t used_ = 0;
+    std::list<Entry> entries_;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+};
+
+static SearchCache g_search_cache(32 * 1024 * 1024);
+
+// ───────────────────────────────────────────────
+//  Offline search index
+// ───────────────────────────────────────────────
+
+// Everything `yay -Ss` would search, held in memory: the pacman sync DBs
+// plus the AUR metadata dump, so a search never has to spawn yay or touch
+// the network. Strings live in one arena (identical strings are stored
+// once); records are fixed-width offsets into it. A trigram index over the
+// lower-cased "name\ndescription" text narrows each search term down to a
+// handful of candidates before the final substring check.
+
+static const char *PACMAN_SYNC_DB   = "/var/lib/pacman/sync";
+static const char *AUR_METADATA_URL = "https://aur.archlinux.org/packages-meta-v1.json.gz";
+static const char *AUR_REPO_NAME    = "aur";
+
+// The AUR dump is regenerated upstream every few minutes; once a day is plenty.
+static const gint64 AUR_METADATA_MAX_AGE_SECONDS = 24 * 60 * 60;
+
+struct CatalogRecord {
+    uint32_t name_off, name_len;
+    uint32_t version_off, version_len;
+    uint32_t desc_off, desc_len;
+    uint16_t repo;      // index into Catalog::repos
+    uint16_t flags;     // reserved
+    uint32_t votes;     // AUR votes, 0 for repo packages
+};
+
+// A file the catalog was built from, with the mtime it had at the time.
+struct CatalogSource {
+    std::string path;
+    gint64 mtime;
+};
+
+// A read-only array that points into storage owned elsewhere: vectors
+// filled by CatalogBuilder, or the mapped cache file.
+template <typename T>
+class ArrayRef {
+public:
+    ArrayRef() = default;
+    ArrayRef(const T *data, size_t size) : data_(data), size_(size) {}
+    explicit ArrayRef(const std::vector<T> &v) : data_(v.data()), size_(v.size()) {}
+
+    const T *data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const T *begin() const { return data_; }
+    const T *end() const { return data_ + size_; }
+    const T &operator[](size_t i) const { return data_[i]; }
+    const T &back() const { return data_[size_ - 1]; }
+
+private:
+    const T *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// The bulk of a catalog while it is being built.
+struct CatalogArrays {
+    std::string strings;
+    std::vector<CatalogRecord> records;
+    std::string folded;
+    std::vector<uint32_t> folded_off;
+    std::vector<uint32_t> trigram_keys;
+    std::vector<uint32_t> trigram_start;
+    std::vector<uint32_t> postings;
+};
+
+class Catalog {
+public:
+    Catalog() = default;
+    Catalog(const Catalog &) = delete;
+    Catalog &operator=(const Catalog &) = delete;
+    ~Catalog() {
+        if (mapped_) g_mapped_file_unref(mapped_);
+    }
+
+    std::vector<std::string> repos;
+    std::vector<RepoId> repo_ids;        // repos[i] as a RepoId
+    std::string_view strings;            // interned string arena
+    ArrayRef<CatalogRecord> records;
+    std::string_view folded;             // lower-cased "name\ndesc", per record
+    ArrayRef<uint32_t> folded_off;       // records.size() + 1 offsets into `folded`
+    ArrayRef<uint32_t> trigram_keys;     // sorted
+    ArrayRef<uint32_t> trigram_start;    // trigram_keys.size() + 1 offsets
+    ArrayRef<uint32_t> postings;         // record ids, ascending per trigram
+    std::vector<CatalogSource> sources;
+    bool has_aur = false;
+    bool complete = true;                // false if some sync DB could not be read
+
+    std::string_view str(uint32_t off, uint32_t len) const {
+        return strings.substr(off, len);
+    }
+
+    // Views into this catalog: keep it alive while the package is in use.
+    PackageInfo package(uint32_t id) const {
+        const CatalogRecord &rec = records[id];
+        PackageInfo pkg;
+        pkg.repo = repo_ids[rec.repo];
+        pkg.name = str(rec.name_off, rec.name_len);
+        pkg.version = str(rec.version_off, rec.version_len);
+        pkg.description = str(rec.desc_off, rec.desc_len);
+        pkg.votes = rec.votes;
+        return pkg;
+    }
+
+    // Map `repos` to process-wide RepoIds; once `repos` is final.
+    void intern_repos() {
+        repo_ids.clear();
+        for (const auto &repo : repos) repo_ids.push_back(intern_repo(repo));
+    }
+
+    // Ids of records where every term (lower-cased) occurs in the name or
+    // description, in catalog order (repos first, then AUR), like `-Ss`.
+    std::vector<uint32_t> search(const std::vector<std::string> &terms) const;
+
+    // Take ownership of freshly built arrays and point the views at them.
+    void adopt(std::unique_ptr<CatalogArrays> arrays) {
+        owned_ = std::move(arrays);
+        strings = owned_->strings;
+        records = ArrayRef<CatalogRecord>(owned_->records);
+        folded = owned_->folded;
+        folded_off = ArrayRef<uint32_t>(owned_->folded_off);
+        trigram_keys = ArrayRef<uint32_t>(owned_->trigram_keys);
+        trigram_start = ArrayRef<uint32_t>(owned_->trigram_start);
+        postings = ArrayRef<uint32_t>(owned_->postings);
+    }
+
+    // Keep a mapped cache file alive for as long as the views point into it.
+    void adopt(GMappedFile *mapped) { mapped_ = mapped; }
+
+private:
+    // Postings for one trigram, or an empty range if it never occurs.
+    std::pair<const uint32_t *, const uint32_t *> postings_for(uint32_t key) const {
+        auto it = std::lower_bound(trigram_keys.begin(), trigram_keys.end(), key);
+        if (it == trigram_keys.end() || *it != key) return { nullptr, nullptr };
+        size_t k = static_cast<size_t>(it - trigram_keys.begin());
+        return { postings.data() + trigram_start[k], postings.data() + trigram_start[k + 1] };
+    }
+
+    std::unique_ptr<CatalogArrays> owned_;
+    GMappedFile *mapped_ = nullptr;
+};
+using CatalogPtr = std::shared_ptr<const Catalog>;
+
+static inline char fold_ascii(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+static inline uint32_t trigram_key(const char *p) {
+    return (static_cast<uint32_t>(static_cast<unsigned char>(p[0])) << 16) |
+           (static_cast<uint32_t>(static_cast<unsigned char>(p[1])) << 8) |
+            static_cast<uint32_t>(static_cast<unsigned char>(p[2]));
+}
+
+// Distinct trigrams of `text`, skipping ones that span the name/desc break.
+static void collect_trigrams(std::string_view text, std::vector<uint32_t> &out) {
+    out.clear();
+    for (size_t i = 0; i + 3 <= text.size(); i++) {
+        if (text[i] == '\n' || text[i + 1] == '\n' || text[i + 2] == '\n') continue;
+        out.push_back(trigram_key(text.data() + i));
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+std::vector<uint32_t> Catalog::search(const std::vector<std::string> &terms) const {
+    std::vector<uint32_t> candidates;
+    bool have_candidates = false;
+    std::vector<uint32_t> grams;
+
+    for (const auto &term : terms) {
+        if (term.size() < 3) continue;
+
+        collect_trigrams(term, grams);
+        std::vector<std::pair<const uint32_t *, const uint32_t *>> lists;
+        for (uint32_t key : grams) {
+            auto range = postings_for(key);
+            if (range.first == range.second) return {};
+            lists.push_back(range);
+        }
+
+        // Intersect, rarest list first.
+        std::sort(lists.begin(), lists.end(), [](const auto &a, const auto &b) {
+            return (a.second - a.first) < (b.second - b.first);
+        });
+        for (const auto &list : lists) {
+            if (!have_candidates) {
+                candidates.assign(list.first, list.second);
+                have_candidates = true;
+                continue;
+            }
+            std::vector<uint32_t> narrowed;
+            std::set_intersection(candidates.begin(), candidates.end(),
+                                  list.first, list.second,
+                                  std::back_inserter(narrowed));
+            candidates.swap(narrowed);
+            if (candidates.empty()) return {};
+        }
+    }
+
+    // Only one- and two-letter terms: nothing to narrow with, scan everything.
+    if (!have_candidates) {
+        candidates.resize(records.size());
+        for (uint32_t i = 0; i < candidates.size(); i++) candidates[i] = i;
+    }
+
+    std::vector<uint32_t> matches;
+    for (uint32_t id : candidates) {
+        std::string_view text(folded.data() + folded_off[id], folded_off[id + 1] - folded_off[id]);
+        bool all = true;
+        for (const auto &term : terms) {
+            if (text.find(term) == std::string_view::npos) {
+                all = false;
+                break;
+            }
+        }
+        if (all) matches.push_back(id);
+    }
+    return matches;
+}
+
+// Accumulates records and builds the folded text and trigram index.
+class CatalogBuilder {
+public:
+    CatalogBuilder()
+        : catalog_(std::make_shared<Catalog>()), arrays_(std::make_unique<CatalogArrays>()) {}
+
+    uint16_t repo(const std::string &name) {
+        for (size_t i = 0; i < catalog_->repos.size(); i++) {
+            if (catalog_->repos[i] == name) return static_cast<uint16_t>(i);
+        }
+        catalog_->repos.push_back(name);
+        return static_cast<uint16_t>(catalog_->repos.size() - 1);
+    }
+
+    void add(uint16_t repo, std::string_view name, std::string_view version,
+             std::string_view desc, uint32_t votes) {
+        if (name.empty()) return;
+
+        CatalogRecord rec{};
+        rec.repo = repo;
+        rec.votes = votes;
+        intern(name, rec.name_off, rec.name_len);
+        intern(version, rec.version_off, rec.version_len);
+        intern(desc, rec.desc_off, rec.desc_len);
+        arrays_->records.push_back(rec);
+    }
+
+    Catalog &catalog() { return *catalog_; }
+
+    std::shared_ptr<Catalog> finish() {
+        CatalogArrays &a = *arrays_;
+        const uint32_t count = static_cast<uint32_t>(a.records.size());
+
+        a.folded_off.reserve(count + 1);
+        for (const auto &rec : a.records) {
+            a.folded_off.push_back(static_cast<uint32_t>(a.folded.size()));
+            for (size_t i = 0; i < rec.name_len; i++) a.folded.push_back(fold_ascii(a.strings[rec.name_off + i]));
+            a.folded.push_back('\n');
+            for (size_t i = 0; i < rec.desc_len; i++) a.folded.push_back(fold_ascii(a.strings[rec.desc_off + i]));
+        }
+        a.folded_off.push_back(static_cast<uint32_t>(a.folded.size()));
+
+        // Two passes: count postings per trigram, then fill them in
+        // record order, which leaves every list sorted.
+        std::unordered_map<uint32_t, uint32_t> counts;
+        std::vector<uint32_t> grams;
+        for (uint32_t id = 0; id < count; id++) {
+            collect_trigrams(folded_text(id), grams);
+            for (uint32_t key : grams) counts[key]++;
+        }
+
+        a.trigram_keys.reserve(counts.size());
+        for (const auto &kv : counts) a.trigram_keys.push_back(kv.first);
+        std::sort(a.trigram_keys.begin(), a.trigram_keys.end());
+
+        a.trigram_start.reserve(a.trigram_keys.size() + 1);
+        uint32_t total = 0;
+        for (uint32_t key : a.trigram_keys) {
+            a.trigram_start.push_back(total);
+            uint32_t n = counts[key];
+            counts[key] = total; // reuse as the fill cursor
+            total += n;
+        }
+        a.trigram_start.push_back(total);
+
+        a.postings.resize(total);
+        for (uint32_t id = 0; id < count; id++) {
+            collect_trigrams(folded_text(id), grams);
+            for (uint32_t key : grams) a.postings[counts[key]++] = id;
+        }
+
+        interned_.clear();
+        catalog_->intern_repos();
+        catalog_->adopt(std::move(arrays_));
+        return std::move(catalog_);
+    }
+
+private:
+    std::string_view folded_text(uint32_t id) const {
+        const CatalogArrays &a = *arrays_;
+        return std::string_view(a.folded.data() + a.folded_off[id],
+                                a.folded_off[id + 1] - a.folded_off[id]);
+    }
+
+    void intern(std::string_view s, uint32_t &off, uint32_t &len) {
+        len = static_cast<uint32_t>(s.size());
+        auto it = interned_.find(std::string(s));
+        if (it != interned_.end()) {
+            off = it->second;
+            return;
+        }
+        off = static_cast<uint32_t>(arrays_->strings.size());
+        arrays_->strings.append(s.data(), s.size());
+        interned_.emplace(std::string(s), off);
+    }
+
+    std::shared_ptr<Catalog> catalog_;
+    std::unique_ptr<CatalogArrays> arrays_;
+    std::unordered_map<std::string, uint32_t> interned_;
+};
+
+static gint64 file_mtime(const std::string &path) {
+    GStatBuf st;
+    if (g_stat(path.c_str(), &st) != 0) return -1;
+    return static_cast<gint64>(st.st_mtime);
+}
+
+// Read a whole file, transparently gunzipping it if it starts with the
+// gzip magic. Returns false on I/O errors or if the file uses some other
+// compression (e.g. zstd) we cannot read.
+static bool read_maybe_gzip(const std::string &path, std::string &out) {
+    out.clear();
+
+    GFile *file = g_file_new_for_path(path.c_str());
+    GFileInputStream *raw = g_file_read(file, nullptr, nullptr);
+    g_object_unref(file);
+    if (!raw) return false;
+
+    guchar magic[2] = { 0, 0 };
+    gsize got = 0;
+    g_input_stream_read_all(G_INPUT_STREAM(raw), magic, sizeof(magic), &got, nullptr, nullptr);
+    g_seekable_seek(G_SEEKABLE(raw), 0, G_SEEK_SET, nullptr, nullptr);
+
+    GInputStream *in = G_INPUT_STREAM(raw);
+    if (got == 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+        GZlibDecompressor *gz = g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP);
+        in = g_converter_input_stream_new(G_INPUT_STREAM(raw), G_CONVERTER(gz));
+        g_object_unref(gz);
+        g_object_unref(raw);
+    }
+
+    bool ok = true;
+    std::vector<char> buffer(256 * 1024);
+    for (;;) {
+        GError *error = nullptr;
+        gssize n = g_input_stream_read(in, buffer.data(), buffer.size(), nullptr, &error);
+        if (n < 0) {
+            g_clear_error(&error);
+            ok = false;
+            break;
+        }
+        if (n == 0) break;
+        out.append(buffer.data(), static_cast<size_t>(n));
+    }
+    g_object_unref(in);
+    return ok;
+}
+
+// Values of the %NAME%, %VERSION% and %DESC% sections of a sync DB "desc" file.
+static void parse_desc_file(std::string_view text, std::string_view &name,
+                            std::string_view &version, std::string_view &desc) {
+    std::string_view *want = nullptr;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t nl = text.find('\n', pos);
+        if (nl == std::string_view::npos) nl = text.size();
+        std::string_view line = text.substr(pos, nl - pos);
+        pos = nl + 1;
+
+        if (line.empty()) {
+            want = nullptr;
+        } else if (line.front() == '%' && line.back() == '%') {
+            want = line == "%NAME%" ? &name
+                 : line == "%VERSION%" ? &version
+                 : line == "%DESC%" ? &desc
+                 : nullptr;
+        } else if (want) {
+            *want = line; // first value line only
+            want = nullptr;
+        }
+    }
+}
+
+// A sync DB is a tar archive with one "<pkg>-<ver>/desc" file per package.
+// Calls `fn(name, version, desc)` for each of them.
+template <typename Fn>
+static bool visit_sync_db(const std::string &path, Fn &&fn) {
+    std::string tar;
+    if (!read_maybe_gzip(path, tar)) return false;
+
+    size_t pos = 0;
+    std::string long_name; // GNU 'L' entries carry the next entry's full name
+    while (pos + 512 <= tar.size()) {
+        const char *hdr = tar.data() + pos;
+        if (hdr[0] == '\0') break; // end-of-archive block
+
+        std::string_view entry(hdr, strnlen(hdr, 100));
+        size_t size = static_cast<size_t>(strtoull(std::string(hdr + 124, 12).c_str(), nullptr, 8));
+        char type = hdr[156];
+        pos += 512;
+        if (pos + size > tar.size()) return false;
+
+        if (type == 'L') {
+            long_name.assign(tar.data() + pos, strnlen(tar.data() + pos, size));
+            pos += (size + 511) & ~static_cast<size_t>(511);
+            continue;
+        }
+        std::string full_name = long_name.empty() ? std::string(entry) : long_name;
+        long_name.clear();
+        entry = full_name;
+
+        bool is_file = (type == '0' || type == '\0');
+        if (is_file && entry.size() > 5 && entry.substr(entry.size() - 5) == "/desc") {
+            std::string_view name, version, desc;
+            parse_desc_file(std::string_view(tar.data() + pos, size), name, version, desc);
+            fn(name, version, desc);
+        }
+
+        pos += (size + 511) & ~static_cast<size_t>(511);
+    }
+    return true;
+}
+
+static bool load_sync_db(const std::string &path, uint16_t repo, CatalogBuilder &builder) {
+    return visit_sync_db(path, [&](std::string_view name, std::string_view version,
+                                   std::string_view desc) {
+        builder.add(repo, name, version, desc, 0);
+    });
+}
+
+#ifdef COLOSSUS_WITH_ALPM
+// Same as visit_sync_db(), through libalpm: handles every DB compression
+// pacman does and gives us structured fields instead of parsed text.
+template <typename Fn>
+static bool alpm_visit_sync_db(alpm_handle_t *handle, const std::string &name, Fn &&fn) {
+    alpm_db_t *db = alpm_register_syncdb(handle, name.c_str(), ALPM_SIG_USE_DEFAULT);
+    if (!db) return false;
+
+    alpm_list_t *pkgs = alpm_db_get_pkgcache(db);
+    if (!pkgs && alpm_errno(handle) != ALPM_ERR_OK) return false;
+
+    for (alpm_list_t *it = pkgs; it; it = it->next) {
+        auto *pkg = static_cast<alpm_pkg_t *>(it->data);
+        const char *desc = alpm_pkg_get_desc(pkg);
+        fn(alpm_pkg_get_name(pkg), alpm_pkg_get_version(pkg), desc ? desc : "");
+    }
+    return true;
+}
+
+static bool alpm_load_sync_db(alpm_handle_t *handle, const std::string &name,
+                              uint16_t repo, CatalogBuilder &builder) {
+    return alpm_visit_sync_db(handle, name, [&](std::string_view pkg_name,
+                                                std::string_view version,
+                                                std::string_view desc) {
+        builder.add(repo, pkg_name, version, desc, 0);
+    });
+}
+#endif
+
+// Order repos the way a stock pacman.conf lists them; anything else after.
+static int sync_db_rank(const std::string &repo) {
+    static const char *known[] = { "core-testing", "core", "extra-testing", "extra",
+                                   "multilib-testing", "multilib" };
+    for (int i = 0; i < static_cast<int>(G_N_ELEMENTS(known)); i++) {
+        if (repo == known[i]) return i;
+    }
+    return static_cast<int>(G_N_ELEMENTS(known));
+}
+
+// The "*.db" files in `sync_dir`, in the order pacman would look at them.
+static std::vector<std::string> list_sync_dbs(const std::string &sync_dir) {
+    std::vector<std::string> dbs;
+    GDir *dir = g_dir_open(sync_dir.c_str(), 0, nullptr);
+    if (dir) {
+        const gchar *entry;
+        while ((entry = g_dir_read_name(dir)) != nullptr) {
+            if (g_str_has_suffix(entry, ".db")) dbs.push_back(entry);
+        }
+        g_dir_close(dir);
+    }
+    std::sort(dbs.begin(), dbs.end(), [](const std::string &a, const std::string &b) {
+        int ra = sync_db_rank(a.substr(0, a.size() - 3));
+        int rb = sync_db_rank(b.substr(0, b.size() - 3));
+        return ra != rb ? ra < rb : a < b;
+    });
+    return dbs;
+}
+
+// Minimal JSON reader, just enough for the AUR metadata dump: an array of
+// flat objects whose values are strings, numbers, booleans or null.
+class JsonReader {
+public:
+    JsonReader(const char *p, const char *end) : p_(p), end_(end) {}
+
+    bool at_end() { skip_ws(); return p_ >= end_; }
+    bool consume(char c) {
+        skip_ws();
+        if (p_ < end_ && *p_ == c) { p_++; return true; }
+        return false;
+    }
+    char peek() { skip_ws(); return p_ < end_ ? *p_ : '\0'; }
+
+    bool read_string(std::string &out) {
+        out.clear();
+        if (!consume('"')) return false;
+        while (p_ < end_) {
+            char c = *p_++;
+            if (c == '"') return true;
+            if (c != '\\') {
+                out.push_back(c);
+                continue;
+            }
+            if (p_ >= end_) return false;
+            char e = *p_++;
+            switch (e) {
+            case 'n': out.push_back('\n'); break;
+            case 't': out.push_back('\t'); break;
+            case 'r': out.push_back('\r'); break;
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'u': {
+                gunichar cp = 0;
+                if (!read_hex4(cp)) return false;
+                if (cp >= 0xD800 && cp <= 0xDBFF && p_ + 1 < end_ && p_[0] == '\\' && p_[1] == 'u') {
+                    p_ += 2;
+                    gunichar lo = 0;
+                    if (!read_hex4(lo)) return false;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                }
+                char utf8[6];
+                out.append(utf8, static_cast<size_t>(g_unichar_to_utf8(cp, utf8)));
+                break;
+            }
+            default: out.push_back(e); break; // \" \\ \/
+            }
+        }
+        return false;
+    }
+
+    // Any scalar as text (numbers verbatim, null as empty); nested values skipped.
+    bool read_scalar(std::string &out) {
+        char c = peek();
+        if (c == '"') return read_string(out);
+        if (c == '{' || c == '[') {
+            out.clear();
+            return skip_value();
+        }
+        out.clear();
+        while (p_ < end_ && *p_ != ',' && *p_ != '}' && *p_ != ']' &&
+               !g_ascii_isspace(*p_)) {
+            out.push_back(*p_++);
+        }
+        if (out == "null") out.clear();
+        return true;
+    }
+
+    bool skip_value() {
+        char c = peek();
+        if (c == '"') {
+            std::string ignored;
+            return read_string(ignored);
+        }
+        if (c == '{' || c == '[') {
+            char close = (c == '{') ? '}' : ']';
+            p_++;
+            if (consume(close)) return true;
+            do {
+                if (c == '{') {
+                    std::string key;
+                    if (!read_string(key) || !consume(':')) return false;
+                }
+                if (!skip_value()) return false;
+            } while (consume(','));
+            return consume(close);
+        }
+        std::string ignored;
+        return read_scalar(ignored);
+    }
+
+private:
+    void skip_ws() {
+        while (p_ < end_ && g_ascii_isspace(*p_)) p_++;
+    }
+
+    bool read_hex4(gunichar &cp) {
+        if (end_ - p_ < 4) return false;
+        for (int i = 0; i < 4; i++) {
+            int v = g_ascii_xdigit_value(*p_++);
+            if (v < 0) return false;
+            cp = (cp << 4) | static_cast<gunichar>(v);
+        }
+        return true;
+    }
+
+    const char *p_;
+    const char *end_;
+};
+
+static std::string aur_metadata_path() {
+    gchar *path = g_build_filename(g_get_user_cache_dir(), "colossus-pkgcenter",
+                                   "packages-meta-v1.json.gz", nullptr);
+    std::string result(path);
+    g_free(path);
+    return result;
+}
+
+static bool load_aur_metadata(const std::string &path, CatalogBuilder &builder) {
+    std::string json;
+    if (!read_maybe_gzip(path, json)) return false;
+
+    uint16_t repo = builder.repo(AUR_REPO_NAME);
+    JsonReader reader(json.data(), json.data() + json.size());
+    if (!reader.consume('[')) return false;
+    if (reader.consume(']')) return true;
+
+    std::string key, value, name, version, desc;
+    do {
+        if (!reader.consume('{')) return false;
+        name.clear();
+        version.clear();
+        desc.clear();
+        uint32_t votes = 0;
+
+        if (!reader.consume('}')) {
+            do {
+                if (!reader.read_string(key) || !reader.consume(':')) return false;
+                if (!reader.read_scalar(value)) return false;
+                if (key == "Name") name = value;
+                else if (key == "Version") version = value;
+                else if (key == "Description") desc = value;
+                else if (key == "NumVotes") votes = static_cast<uint32_t>(g_ascii_strtoull(value.c_str(), nullptr, 10));
+            } while (reader.consume(','));
+            if (!reader.consume('}')) return false;
+        }
+
+        builder.add(repo, name, version, desc, votes);
+    } while (reader.consume(','));
+
+    return reader.consume(']');
+}
+
+// Build a fresh catalog from disk. Slow (hundreds of ms); worker thread only.
+std::shared_ptr<Catalog> build_catalog() {
+    CatalogBuilder builder;
+    Catalog &cat = builder.catalog();
+
+    std::vector<std::string> dbs = list_sync_dbs(PACMAN_SYNC_DB);
+
+#ifdef COLOSSUS_WITH_ALPM
+    alpm_handle_t *handle = open_alpm_handle();
+#endif
+
+    for (const auto &db : dbs) {
+        std::string path = std::string(PACMAN_SYNC_DB) + "/" + db;
+        std::string repo_name = db.substr(0, db.size() - 3);
+        uint16_t repo = builder.repo(repo_name);
+        cat.sources.push_back({ path, file_mtime(path) });
+
+        bool loaded = false;
+#ifdef COLOSSUS_WITH_ALPM
+        if (handle) loaded = alpm_load_sync_db(handle, repo_name, repo, builder);
+#endif
+        if (!loaded) loaded = load_sync_db(path, repo, builder);
+
+        if (!loaded) {
+            g_printerr("Offline index: could not read %s\n", path.c_str());
+            cat.complete = false;
+        }
+    }
+    if (dbs.empty()) cat.complete = false;
+
+#ifdef COLOSSUS_WITH_ALPM
+    if (handle) alpm_release(handle);
+#endif
+
+    std::string aur = aur_metadata_path();
+    gint64 aur_mtime = file_mtime(aur);
+    cat.sources.push_back({ aur, aur_mtime });
+    if (aur_mtime >= 0) {
+        cat.has_aur = load_aur_metadata(aur, builder);
+        if (!cat.has_aur) g_printerr("Offline index: could not parse %s\n", aur.c_str());
+    }
+
+    return builder.finish();
+}
+
+// On-disk copy of the catalog, so a fresh start can search right away.
+// A versioned, native-endian header followed by 8-byte aligned sections
+// that mirror the catalog's arrays. Loading maps the file and points the
+// catalog's views straight into it: nothing is parsed or copied apart from
+// the repo and source lists. A file that does not check out is ignored.
+static const char CATALOG_CACHE_MAGIC[8] = { 'C', 'O', 'L', 'C', 'A', 'T', '\0', '\0' };
+static const uint32_t CATALOG_CACHE_VERSION = 1;
+static const uint32_t CATALOG_CACHE_BYTE_ORDER = 0x01020304;
+
+enum CatalogSection {
+    SECTION_REPOS = 0,      // NUL-terminated names
+    SECTION_SOURCES,        // per source: int64 mtime, NUL-terminated path
+    SECTION_STRINGS,
+    SECTION_RECORDS,
+    SECTION_FOLDED,
+    SECTION_FOLDED_OFF,
+    SECTION_TRIGRAM_KEYS,
+    SECTION_TRIGRAM_START,
+    SECTION_POSTINGS,
+    SECTION_COUNT
+};
+
+enum {
+    CATALOG_CACHE_HAS_AUR  = 1 << 0,
+    CATALOG_CACHE_COMPLETE = 1 << 1,
+};
+
+struct CatalogCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t record_size;   // sizeof(CatalogRecord); catches layout changes
+    uint32_t flags;
+    uint64_t file_size;
+    struct {
+        uint64_t offset;
+        uint64_t size;      // bytes
+    } sections[SECTION_COUNT];
+};
+
+static std::string catalog_cache_path() {
+    gchar *path = g_build_filename(g_get_user_cache_dir(), "colossus-pkgcenter",
+                                   "catalog.bin", nullptr);
+    std::string result(path);
+    g_free(path);
+    return result;
+}
+
+static inline uint64_t align8(uint64_t n) {
+    return (n + 7) & ~static_cast<uint64_t>(7);
+}
+
+// Write `cat` to `path` via a temporary file and rename(), so readers only
+// ever see a complete file. Worker thread is fine.
+static bool save_catalog_cache(const Catalog &cat, const std::string &path) {
+    std::string repos;
+    for (const auto &repo : cat.repos) {
+        repos += repo;
+        repos.push_back('\0');
+    }
+    std::string sources;
+    for (const auto &src : cat.sources) {
+        int64_t mtime = src.mtime;
+        sources.append(reinterpret_cast<const char *>(&mtime), sizeof(mtime));
+        sources += src.path;
+        sources.push_back('\0');
+    }
+
+    const std::pair<const void *, uint64_t> data[SECTION_COUNT] = {
+        { repos.data(), repos.size() },
+        { sources.data(), sources.size() },
+        { cat.strings.data(), cat.strings.size() },
+        { cat.records.data(), cat.records.size() * sizeof(CatalogRecord) },
+        { cat.folded.data(), cat.folded.size() },
+        { cat.folded_off.data(), cat.folded_off.size() * sizeof(uint32_t) },
+        { cat.trigram_keys.data(), cat.trigram_keys.size() * sizeof(uint32_t) },
+        { cat.trigram_start.data(), cat.trigram_start.size() * sizeof(uint32_t) },
+        { cat.postings.data(), cat.postings.size() * sizeof(uint32_t) },
+    };
+
+    CatalogCacheHeader header{};
+    memcpy(header.magic, CATALOG_CACHE_MAGIC, sizeof(header.magic));
+    header.version = CATALOG_CACHE_VERSION;
+    header.byte_order = CATALOG_CACHE_BYTE_ORDER;
+    header.record_size = sizeof(CatalogRecord);
+    header.flags = (cat.has_aur ? CATALOG_CACHE_HAS_AUR : 0) |
+                   (cat.complete ? CATALOG_CACHE_COMPLETE : 0);
+
+    uint64_t offset = align8(sizeof(header));
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        header.sections[i].offset = offset;
+        header.sections[i].size = data[i].second;
+        offset = align8(offset + data[i].second);
+    }
+    header.file_size = offset;
+
+    gchar *dir = g_path_get_dirname(path.c_str());
+    g_mkdir_with_parents(dir, 0755);
+    g_free(dir);
+
+    // The GUI and a --service process may both be saving: each writes its
+    // own temp file, so neither truncates the other's or writes into the
+    // file already renamed into place (and mmapped elsewhere).
+    gchar *tmpl = g_strdup((path + ".XXXXXX").c_str());
+    int fd = g_mkstemp(tmpl);
+    std::string tmp = tmpl;
+    g_free(tmpl);
+    if (fd < 0) return false;
+    FILE *out = fdopen(fd, "wb");
+    if (!out) {
+        close(fd);
+        g_unlink(tmp.c_str());
+        return false;
+    }
+
+    static const char padding[8] = {};
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+    uint64_t written = sizeof(header);
+    for (int i = 0; ok && i < SECTION_COUNT; i++) {
+        uint64_t pad = header.sections[i].offset - written;
+        ok = (pad == 0 || fwrite(padding, 1, pad, out) == pad) &&
+             (data[i].second == 0 || fwrite(data[i].first, 1, data[i].second, out) == data[i].second);
+        written = header.sections[i].offset + data[i].second;
+    }
+    if (ok && written < header.file_size) {
+        uint64_t pad = header.file_size - written;
+        ok = fwrite(padding, 1, pad, out) == pad;
+    }
+    ok = (fclose(out) == 0) && ok;
+
+    if (!ok || g_rename(tmp.c_str(), path.c_str()) != 0) {
+        g_printerr("Offline index: could not write %s\n", path.c_str());
+        g_unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+template <typename T>
+static bool cache_section(const char *base, const CatalogCacheHeader &header,
+                          CatalogSection which, ArrayRef<T> &out) {
+    const auto &sec = header.sections[which];
+    if (sec.offset % alignof(T) != 0 || sec.size % sizeof(T) != 0) return false;
+    out = ArrayRef<T>(reinterpret_cast<const T *>(base + sec.offset), sec.size / sizeof(T));
+    return true;
+}
+
+// One linear pass over a mapped catalog: every record's strings inside
+// `strings` and its repo known, offset arrays non-decreasing, trigram keys
+// sorted and every posting a record id. A corrupt file that passes the
+// size checks would otherwise be read out of bounds by searches.
+static bool catalog_cache_consistent(const Catalog &cat) {
+    TraceScope trace("check catalog cache");
+    uint64_t strings = cat.strings.size();
+    auto inside = [strings](uint32_t off, uint32_t len) {
+        return off <= strings && len <= strings - off;
+    };
+    for (const auto &rec : cat.records) {
+        if (!inside(rec.name_off, rec.name_len) || !inside(rec.version_off, rec.version_len) ||
+            !inside(rec.desc_off, rec.desc_len) || rec.repo >= cat.repos.size()) {
+            return false;
+        }
+    }
+    for (size_t i = 1; i < cat.folded_off.size(); i++) {
+        if (cat.folded_off[i] < cat.folded_off[i - 1]) return false;
+    }
+    for (size_t i = 1; i < cat.trigram_keys.size(); i++) {
+        if (cat.trigram_keys[i] <= cat.trigram_keys[i - 1]) return false;
+    }
+    for (size_t i = 1; i < cat.trigram_start.size(); i++) {
+        if (cat.trigram_start[i] < cat.trigram_start[i - 1]) return false;
+    }
+    for (uint32_t id : cat.postings) {
+        if (id >= cat.records.size()) return false;
+    }
+    return true;
+}
+
+// Map the cache file written by save_catalog_cache. Returns null if there
+// is none, it does not match this build, or any offset in it points
+// outside its section (see catalog_cache_consistent).
+static std::shared_ptr<Catalog> load_catalog_cache(const std::string &path) {
+    TraceScope trace("load_catalog_cache");
+    GMappedFile *mapped = g_mapped_file_new(path.c_str(), FALSE, nullptr);
+    if (!mapped) return nullptr;
+
+    auto cat = std::make_shared<Catalog>();
+    cat->adopt(mapped); // unmapped with `cat`, on any return below
+
+    const char *base = g_mapped_file_get_contents(mapped);
+    uint64_t size = g_mapped_file_get_length(mapped);
+    if (!base || size < sizeof(CatalogCacheHeader)) return nullptr;
+
+    CatalogCacheHeader header;
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, CATALOG_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != CATALOG_CACHE_VERSION ||
+        header.byte_order != CATALOG_CACHE_BYTE_ORDER ||
+        header.record_size != sizeof(CatalogRecord) ||
+        header.file_size != size) {
+        return nullptr;
+    }
+    for (const auto &sec : header.sections) {
+        if (sec.offset > size || sec.size > size - sec.offset) return nullptr;
+    }
+
+    const auto &repos = header.sections[SECTION_REPOS];
+    for (uint64_t p = repos.offset, end = repos.offset + repos.size; p < end; ) {
+        const char *name = base + p;
+        size_t len = strnlen(name, end - p);
+        if (p + len >= end) return nullptr;
+        cat->repos.emplace_back(name, len);
+        p += len + 1;
+    }
+
+    const auto &sources = header.sections[SECTION_SOURCES];
+    for (uint64_t p = sources.offset, end = sources.offset + sources.size; p < end; ) {
+        int64_t mtime;
+        if (end - p < sizeof(mtime)) return nullptr;
+        memcpy(&mtime, base + p, sizeof(mtime));
+        p += sizeof(mtime);
+        const char *src = base + p;
+        size_t len = strnlen(src, end - p);
+        if (p + len >= end) return nullptr;
+        cat->sources.push_back({ std::string(src, len), mtime });
+        p += len + 1;
+    }
+
+    const auto &strings = header.sections[SECTION_STRINGS];
+    const auto &folded = header.sections[SECTION_FOLDED];
+    cat->strings = std::string_view(base + strings.offset, strings.size);
+    cat->folded = std::string_view(base + folded.offset, folded.size);
+
+    if (!cache_section(base, header, SECTION_RECORDS, cat->records) ||
+        !cache_section(base, header, SECTION_FOLDED_OFF, cat->folded_off) ||
+        !cache_section(base, header, SECTION_TRIGRAM_KEYS, cat->trigram_keys) ||
+        !cache_section(base, header, SECTION_TRIGRAM_START, cat->trigram_start) ||
+        !cache_section(base, header, SECTION_POSTINGS, cat->postings)) {
+        return nullptr;
+    }
+
+    // The arrays must agree with each other, or lookups would run off the end.
+    if (cat->folded_off.size() != cat->records.size() + 1 ||
+        cat->folded_off.back() != cat->folded.size() ||
+        cat->trigram_start.size() != cat->trigram_keys.size() + 1 ||
+        cat->trigram_start.back() != cat->postings.size() ||
+        cat->repos.empty() || cat->repos.size() > UINT16_MAX) {
+        return nullptr;
+    }
+
+    if (!catalog_cache_consistent(*cat)) return nullptr;
+
+    cat->intern_repos();
+    cat->has_aur = (header.flags & CATALOG_CACHE_HAS_AUR) != 0;
+    cat->complete = (header.flags & CATALOG_CACHE_COMPLETE) != 0;
+    return cat;
+}
+
+// The catalog searches are answered from, once it is built.
+static CatalogPtr g_catalog;
+static bool g_catalog_building = false;
+static bool g_catalog_rebuild_pending = false;
+
+// Building the index: heavy, so it gets its own lane.
+static JobQueue *g_index_jobs = nullptr;
+
+// Usable for searches only if it covers everything `yay -Ss` would.
+static bool catalog_ready() {
+    return g_catalog && g_catalog->has_aur && g_catalog->complete;
+}
+
+void rebuild_catalog() {
+    if (g_catalog_building) {
+        g_catalog_rebuild_pending = true;
+        return;
+    }
+    g_catalog_building = true;
+
+    auto built = std::make_shared<std::shared_ptr<Catalog>>();
+    auto job = std::make_shared<Job>();
+    job->work = [built](Job &) {
+        {
+            TraceScope trace("build_catalog");
+            *built = build_catalog();
+        }
+        TraceScope trace("save_catalog_cache");
+        if (*built) save_catalog_cache(**built, catalog_cache_path());
+    };
+    job->finished = [built](Job &self) {
+        g_catalog_building = false;
+        if (!self.cancelled && *built) {
+            g_catalog = std::move(*built);
+            g_search_cache.clear();
+        }
+        if (g_catalog_rebuild_pending) {
+            g_catalog_rebuild_pending = false;
+            rebuild_catalog();
+        }
+    };
+    g_index_jobs->submit(job);
+}
+
+// True if a source file changed, or sync DBs were added/removed, since
+// the catalog was built. A few stat() calls; cheap enough per search.
+static bool catalog_is_stale() {
+    if (!g_catalog) return true;
+
+    size_t db_count = 0;
+    GDir *dir = g_dir_open(PACMAN_SYNC_DB, 0, nullptr);
+    if (dir) {
+        const gchar *entry;
+        while ((entry = g_dir_read_name(dir)) != nullptr) {
+            if (g_str_has_suffix(entry, ".db")) db_count++;
+        }
+        g_dir_close(dir);
+    }
+
+    size_t db_sources = 0;
+    for (const auto &src : g_catalog->sources) {
+        if (g_str_has_suffix(src.path.c_str(), ".db")) db_sources++;
+        if (file_mtime(src.path) != src.mtime) return true;
+    }
+    return db_count != db_sources;
+}
+
+// For searches and startup. While a build runs there is nothing to compare
+// against yet (or only the catalog being replaced); the finished build
+// records the stamps the next check uses, so asking again would only queue
+// a second full build of the same DBs.
+static void rebuild_catalog_if_stale() {
+    if (!g_catalog_building && catalog_is_stale()) rebuild_catalog();
+}
+
+// ───────────────────────────────────────────────
+//  AUR RPC client
+// ───────────────────────────────────────────────
+
+// Searches, details lookups and the build scheduler talk to aurweb's RPC
+// in-process, through libcurl on a job lane of their own. The lane keeps
+// a single curl handle, so requests reuse its open connection (and TLS
+// session) instead of paying for a new handshake each time. Replies that
+// carry an ETag or Last-Modified header are revalidated next time with
+// If-None-Match / If-Modified-Since.
+static const char *AUR_RPC_INFO_URL   = "https://aur.archlinux.org/rpc/v5/info";
+static const char *AUR_RPC_SEARCH_URL = "https://aur.archlinux.org/rpc/v5/search/";
+
+// aurweb refuses longer request URIs; info lookups are split to fit.
+static const size_t AUR_RPC_MAX_URL = 4400;
+// Revalidation entries kept before they are dropped wholesale.
+static const size_t AUR_HTTP_CACHE_MAX = 256;
+
+// AUR network requests, one at a time.
+static JobQueue *g_aur_jobs = nullptr;
+
+// Each instance is only ever used from one lane's thread (see aur_http).
+class AurHttpClient {
+public:
+    AurHttpClient() : curl_(curl_easy_init()) {}
+    ~AurHttpClient() {
+        if (curl_) curl_easy_cleanup(curl_);
+    }
+
+    AurHttpClient(const AurHttpClient &) = delete;
+    AurHttpClient &operator=(const AurHttpClient &) = delete;
+
+    // GET `url` into `body`. True for a 200, or for a 304 on a reply we
+    // still have.
+    bool get(const std::string &url, std::string &body) {
+        if (!curl_) return false;
+        TraceScope trace("aur rpc", url);
+
+        auto cached = cache_.find(url);
+        struct curl_slist *headers = nullptr;
+        if (cached != cache_.end()) {
+            if (!cached->second.etag.empty())
+                headers = curl_slist_append(headers, ("If-None-Match: " + cached->second.etag).c_str());
+            if (!cached->second.last_modified.empty())
+                headers = curl_slist_append(headers,
+                                            ("If-Modified-Since: " + cached->second.last_modified).c_str());
+        }
+
+        // Resetting keeps the connection cache, which is the point of reusing the handle.
+        Reply reply;
+        curl_easy_reset(curl_);
+        curl_easy_setopt(curl_, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl_, CURLOPT_USERAGENT, "colossus-pkgcenter");
+        curl_easy_setopt(curl_, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(curl_, CURLOPT_ACCEPT_ENCODING, "");
+        curl_easy_setopt(curl_, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(curl_, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(curl_, CURLOPT_CONNECTTIMEOUT, 10L);
+        curl_easy_setopt(curl_, CURLOPT_TIMEOUT, 30L);
+        curl_easy_setopt(curl_, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, on_body);
+        curl_easy_setopt(curl_, CURLOPT_WRITEDATA, &reply);
+        curl_easy_setopt(curl_, CURLOPT_HEADERFUNCTION, on_header);
+        curl_easy_setopt(curl_, CURLOPT_HEADERDATA, &reply);
+
+        CURLcode rc = curl_easy_perform(curl_);
+        curl_slist_free_all(headers);
+        if (rc != CURLE_OK) {
+            g_printerr("AUR request failed: %s\n", curl_easy_strerror(rc));
+            return false;
+        }
+
+        long status = 0;
+        curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &status);
+        if (status == 304 && cached != cache_.end()) {
+            body = cached->second.body;
+            return true;
+        }
+        if (status != 200) {
+            g_printerr("AUR request failed: HTTP %ld\n", status);
+            return false;
+        }
+
+        if (!reply.etag.empty() || !reply.last_modified.empty()) {
+            if (cache_.size() >= AUR_HTTP_CACHE_MAX) cache_.clear();
+            cache_[url] = Cached{ reply.etag, reply.last_modified, reply.body };
+        }
+        body = std::move(reply.body);
+        return true;
+    }
+
+    // GET `url` straight into `out`, as is (a large file: no revalidation,
+    // no decoding, and no overall timeout). Gives up early once `job` is
+    // cancelled, so shutting down does not wait for the transfer.
+    bool download(const std::string &url, FILE *out, const Job &job) {
+        if (!curl_) return false;
+        TraceScope trace("aur download", url);
+
+        curl_easy_reset(curl_);
+        curl_easy_setopt(curl_, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl_, CURLOPT_USERAGENT, "colossus-pkgcenter");
+        curl_easy_setopt(curl_, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(curl_, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(curl_, CURLOPT_CONNECTTIMEOUT, 10L);
+        curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, on_file);
+        curl_easy_setopt(curl_, CURLOPT_WRITEDATA, out);
+        curl_easy_setopt(curl_, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl_, CURLOPT_XFERINFOFUNCTION, on_progress);
+        curl_easy_setopt(curl_, CURLOPT_XFERINFODATA, &job);
+
+        CURLcode rc = curl_easy_perform(curl_);
+        if (rc != CURLE_OK) {
+            if (!job.cancelled) g_printerr("AUR download failed: %s\n", curl_easy_strerror(rc));
+            return false;
+        }
+        long status = 0;
+        curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &status);
+        if (status != 200) {
+            g_printerr("AUR download failed: HTTP %ld\n", status);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    struct Cached {
+        std::string etag;
+        std::string last_modified;
+        std::string body;
+    };
+    struct Reply {
+        std::string body;
+        std::string etag;
+        std::string last_modified;
+    };
+
+    static size_t on_body(char *data, size_t size, size_t count, void *user) {
+        static_cast<Reply *>(user)->body.append(data, size * count);
+        return size * count;
+    }
+
+    static size_t on_file(char *data, size_t size, size_t count, void *user) {
+        return fwrite(data, size, count, static_cast<FILE *>(user)) * size;
+    }
+
+    static int on_progress(void *user, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+        return static_cast<const Job *>(user)->cancelled ? 1 : 0;
+    }
+
+    static size_t on_header(char *data, size_t size, size_t count, void *user) {
+        auto *reply = static_cast<Reply *>(user);
+        std::string_view line(data, size * count);
+        // A new status line starts the headers of the next (redirected) response.
+        if (line.compare(0, 5, "HTTP/") == 0) {
+            reply->etag.clear();
+            reply->last_modified.clear();
+        }
+        size_t colon = line.find(':');
+        if (colon != std::string_view::npos) {
+            std::string key(line.substr(0, colon));
+            std::string_view rest = line.substr(colon + 1);
+            size_t start = rest.find_first_not_of(" \t");
+            size_t end = rest.find_last_not_of(" \t\r\n");
+            std::string value(start == std::string_view::npos ? std::string_view()
+                                                              : rest.substr(start, end - start + 1));
+            if (g_ascii_strcasecmp(key.c_str(), "ETag") == 0) reply->etag = value;
+            else if (g_ascii_strcasecmp(key.c_str(), "Last-Modified") == 0) reply->last_modified = value;
+        }
+        return size * count;
+    }
+
+    CURL *curl_;
+    std::unordered_map<std::string, Cached> cache_;
+};
+
+static AurHttpClient &aur_http() {
+    static AurHttpClient client; // created on, and confined to, the AUR lane
+    return client;
+}
+
+// The metadata dump is megabytes; it is fetched on the index lane with a
+// handle of its own, so RPC requests do not queue behind it.
+static AurHttpClient &aur_download_http() {
+    static AurHttpClient client; // created on, and confined to, the index lane
+    return client;
+}
+
+static bool g_aur_metadata_fetching = false;
+
+// Download the AUR metadata dump if we have none or it is over a day old,
+// then rebuild the catalog. The file is replaced atomically, from a temp
+// file of our own: the GUI and a --service process may both be fetching.
+void refresh_aur_metadata() {
+    std::string path = aur_metadata_path();
+    gint64 mtime = file_mtime(path);
+    gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+    if (g_aur_metadata_fetching ||
+        (mtime >= 0 && now - mtime < AUR_METADATA_MAX_AGE_SECONDS)) {
+        return;
+    }
+    g_aur_metadata_fetching = true;
+
+    auto ok = std::make_shared<bool>(false);
+    auto job = std::make_shared<Job>();
+    job->work = [path, ok](Job &self) {
+        gchar *dir = g_path_get_dirname(path.c_str());
+        g_mkdir_with_parents(dir, 0755);
+        g_free(dir);
+
+        gchar *tmpl = g_strdup((path + ".XXXXXX").c_str());
+        int fd = g_mkstemp(tmpl);
+        std::string tmp = tmpl;
+        g_free(tmpl);
+        if (fd < 0) return;
+        FILE *out = fdopen(fd, "wb");
+        if (!out) {
+            close(fd);
+            g_unlink(tmp.c_str());
+            return;
+        }
+        bool fetched = aur_download_http().download(AUR_METADATA_URL, out, self);
+        fetched = (fclose(out) == 0) && fetched;
+        *ok = fetched && !self.cancelled && g_rename(tmp.c_str(), path.c_str()) == 0;
+        if (!*ok) g_unlink(tmp.c_str());
+    };
+    job->finished = [ok](Job &self) {
+        g_aur_metadata_fetching = false;
+        if (*ok && !self.cancelled) rebuild_catalog();
+    };
+    g_index_jobs->submit(job);
+}
+
+// Info URLs for `names`, as few as AUR_RPC_MAX_URL allows.
+static std::vector<std::string> aur_info_urls(const std::vector<std::string> &names) {
+    std::vector<std::string> urls;
+    std::string url;
+    for (const auto &name : names) {
+        gchar *escaped = g_uri_escape_string(name.c_str(), nullptr, FALSE);
+        std::string arg = "arg[]=" + std::string(escaped);
+        g_free(escaped);
+
+        if (!url.empty() && url.size() + 1 + arg.size() > AUR_RPC_MAX_URL) {
+            urls.push_back(std::move(url));
+            url.clear();
+        }
+        url += url.empty() ? std::string(AUR_RPC_INFO_URL) + "?" + arg : "&" + arg;
+    }
+    if (!url.empty()) urls.push_back(std::move(url));
+    return urls;
+}
+
+// Look up `names` with RPC "info" requests. `on_done` runs on the main
+// thread with one JSON reply per request; `ok` only if every one worked.
+void aur_rpc_info(const std::vector<std::string> &names,
+                  std::function<void(bool ok, const std::vector<std::string> &replies)> on_done) {
+    auto urls = aur_info_urls(names);
+    auto replies = std::make_shared<std::vector<std::string>>();
+    auto ok = std::make_shared<bool>(true);
+
+    auto job = std::make_shared<Job>();
+    job->work = [urls, replies, ok](Job &self) {
+        for (const auto &url : urls) {
+            if (self.cancelled) break;
+            std::string body;
+            if (aur_http().get(url, body)) replies->push_back(std::move(body));
+            else *ok = false;
+        }
+    };
+    job->finished = [replies, ok, on_done](Job &self) {
+        on_done(*ok && !self.cancelled, *replies);
+    };
+    g_aur_jobs->submit(job);
+}
+
+// Packages from an RPC "search" (or "info") reply that contain every one
+// of `folded` (lowercase) in their name or description. False for a reply
+// that does not parse, or an error reply ({"type":"error", ...}, which
+// aurweb sends with HTTP 200 for e.g. too many results); `error` then
+// says why, if the reply did.
+static bool parse_aur_search(const std::string &json, const std::vector<std::string> &folded,
+                             PackageList &pkgs, std::string *error = nullptr) {
+    auto arena = std::make_shared<StringArena>();
+    pkgs.keep_arena(arena);
+    RepoId aur = intern_repo("aur");
+
+    JsonReader reader(json.data(), json.data() + json.size());
+    if (!reader.consume('{')) return false;
+    if (reader.consume('}')) return true;
+
+    std::string key, value, type, message, name, version, desc, text;
+    do {
+        if (!reader.read_string(key) || !reader.consume(':')) return false;
+        if (key == "type" || key == "error") {
+            if (!reader.read_scalar(value)) return false;
+            (key == "type" ? type : message) = value;
+            continue;
+        }
+        if (key != "results") {
+            if (!reader.skip_value()) return false;
+            continue;
+        }
+        if (!reader.consume('[')) return false;
+        if (reader.consume(']')) continue;
+        do {
+            if (!reader.consume('{')) return false;
+            name.clear();
+            version.clear();
+            desc.clear();
+            uint32_t votes = 0;
+            if (!reader.consume('}')) {
+                do {
+                    if (!reader.read_string(key) || !reader.consume(':')) return false;
+                    if (!reader.read_scalar(value)) return false;
+                    if (key == "Name") name = value;
+                    else if (key == "Version") version = value;
+                    else if (key == "Description") desc = value;
+                    else if (key == "NumVotes") votes = static_cast<uint32_t>(g_ascii_strtoull(value.c_str(), nullptr, 10));
+                } while (reader.consume(','));
+                if (!reader.consume('}')) return false;
+            }
+            if (name.empty()) continue;
+
+            text.clear();
+            for (char c : name) text.push_back(fold_ascii(c));
+            text.push_back('\n');
+            for (char c : desc) text.push_back(fold_ascii(c));
+            bool all = std::all_of(folded.begin(), folded.end(), [&](const std::string &term) {
+                return text.find(term) != std::string::npos;
+            });
+            if (!all) continue;
+
+            PackageInfo pkg;
+            pkg.repo = aur;
+            pkg.name = arena->store(name);
+            pkg.version = arena->store(version);
+            pkg.description = arena->store(desc);
+            pkg.votes = votes;
+            pkgs.items.push_back(pkg);
+        } while (reader.consume(','));
+        if (!reader.consume(']')) return false;
+    } while (reader.consume(','));
+
+    if (type == "error") {
+        if (error) *error = message.empty() ? "error reply" : message;
+        return false;
+    }
+    return true;
+}
+
+// AUR packages matching all of `terms`. The RPC searches for a single
+// argument, so like yay ask for the longest term and filter by the rest.
+// `on_done` runs on the main thread, with aurweb's message when it
+// refused the query. Setting the returned job's `cancelled` before it
+// runs skips the request (a newer search made it pointless).
+JobPtr aur_rpc_search(const std::vector<std::string> &terms,
+                      std::function<void(bool ok, PackageList &pkgs, const std::string &error)> on_done) {
+    std::vector<std::string> folded;
+    for (const auto &term : terms) {
+        std::string f;
+        for (char c : term) f.push_back(fold_ascii(c));
+        folded.push_back(f);
+    }
+    std::string longest = *std::max_element(folded.begin(), folded.end(),
+        [](const std::string &a, const std::string &b) { return a.size() < b.size(); });
+
+    gchar *escaped = g_uri_escape_string(longest.c_str(), nullptr, FALSE);
+    std::string url = std::string(AUR_RPC_SEARCH_URL) + escaped + "?by=name-desc";
+    g_free(escaped);
+
+    auto pkgs = std::make_shared<PackageList>();
+    auto ok = std::make_shared<bool>(false);
+    auto error = std::make_shared<std::string>();
+    auto job = std::make_shared<Job>();
+    job->work = [url, folded, pkgs, ok, error](Job &) {
+        std::string body;
+        *ok = aur_http().get(url, body) && parse_aur_search(body, folded, *pkgs, error.get());
+        if (!error->empty()) g_printerr("AUR search refused: %s\n", error->c_str());
+    };
+    job->finished = [pkgs, ok, error, on_done](Job &self) {
+        on_done(*ok && !self.cancelled, *pkgs, *error);
+    };
+    g_aur_jobs->submit(job);
+    return job;
+}
+
+// ───────────────────────────────────────────────
+//  Globals
+// ───────────────────────────────────────────────
+
+static GtkWidget *g_main_window   = nullptr;
+static GtkWidget *g_search_entry  = nullptr;
+static GtkWidget *g_results_list  = nullptr;
+static GtkListStore *g_results_store = nullptr;
+static GtkWidget *g_status_label  = nullptr;
+static std::string g_sudo_password;
+
+// Packages behind the rows currently in g_results_list, plus totals.
+static PackageList g_results;
+static int g_results_total     = 0;
+static int g_results_installed = 0;
+
+// Every match for g_shown_query. Only the best of them are in g_results;
+// g_match_order is ranked up to g_results.size() (see show_more_matches).
+static PackageList g_matches;
+static std::vector<uint32_t> g_match_order;
+static std::vector<int32_t> g_match_scores;
+
+// Transaction queue (see on_apply_queue_clicked) and its status-bar button.
+static std::vector<std::string> g_queued_installs;
+static std::vector<std::string> g_queued_removals;
+static GtkWidget *g_apply_queue_button = nullptr;
+
+// The query whose results are on screen, and whether they are final
+// (nothing still streaming in); a longer query can then refine them.
+static std::string g_shown_query;
+static bool g_shown_query_complete = false;
+
+// True while the list shows pending upgrades (see check_for_updates)
+// instead of search results.
+static bool g_updates_shown = false;
+
+// Forward declarations
+static void perform_search(const std::string &query, bool allow_refine = true);
+void refresh_installed_flags();
+extern "C" void on_install_clicked(GtkWidget *button, gpointer user_data);
+extern "C" void on_remove_clicked(GtkWidget *button, gpointer user_data);
+extern "C" void on_clean_orphans_clicked(GtkWidget *button, gpointer user_data);
+extern "C" void on_upgrade_all_clicked(GtkWidget *button, gpointer user_data);
+static void leave_updates_view();
+static void update_dependency_graph();
+void prompt_for_sudo_password();
+extern "C" void on_results_cursor_changed(GtkTreeView *view, gpointer user_data);
+static const PackageInfo *package_at(GtkTreeModel *model, GtkTreeIter *iter);
+static std::vector<std::string> split_search_terms(const std::string &query);
+static std::vector<std::string> fold_terms(const std::vector<std::string> &terms);
+
+// ───────────────────────────────────────────────
+//  Package downloads
+// ───────────────────────────────────────────────
+
+// Repo packages are fetched by us, several at a time, into our own cache
+// directory; pacman is then given that directory as an extra --cachedir
+// and finds the files already there. This lets the downloads overlap with
+// AUR builds queued ahead of them, and gives us byte counts to show (pacman
+// prints no progress bars when its output is a pipe).
+static const char *PACMAN_CONF = "/etc/pacman.conf";
+static const int DEFAULT_PARALLEL_DOWNLOADS = 5;
+static const int MAX_PARALLEL_DOWNLOADS = 16;
+static const guint DOWNLOAD_POLL_MS = 250;
+
+struct PacmanOptions {
+    std::string cache_dir = "/var/cache/pacman/pkg/";
+    int parallel_downloads = DEFAULT_PARALLEL_DOWNLOADS;
+};
+
+// The few [options] from pacman.conf we care about. Missing file or keys
+// leave the defaults.
+static PacmanOptions read_pacman_options() {
+    PacmanOptions opts;
+    gchar *contents = nullptr;
+    if (!g_file_get_contents(PACMAN_CONF, &contents, nullptr, nullptr)) return opts;
+
+    bool in_options = false;
+    bool have_cache_dir = false;
+    gchar **lines = g_strsplit(contents, "\n", -1);
+    g_free(contents);
+
+    for (gchar **it = lines; *it; it++) {
+        gchar *line = g_strstrip(*it);
+        if (line[0] == '[') {
+            in_options = strcmp(line, "[options]") == 0;
+            continue;
+        }
+        if (!in_options || line[0] == '#') continue;
+
+        gchar *eq = strchr(line, '=');
+        if (!eq) continue;
+        *eq = '\0';
+        gchar *key = g_strstrip(line);
+        gchar *value = g_strstrip(eq + 1);
+
+        if (strcmp(key, "CacheDir") == 0 && !have_cache_dir && *value) {
+            opts.cache_dir = value;
+            have_cache_dir = true;
+        } else if (strcmp(key, "ParallelDownloads") == 0) {
+            int n = atoi(value);
+            if (n > 0) opts.parallel_downloads = n;
+        }
+    }
+    g_strfreev(lines);
+    return opts;
+}
+
+// $COLOSSUS_PARALLEL_DOWNLOADS, else pacman's ParallelDownloads.
+static int download_concurrency(const PacmanOptions &opts) {
+    int n = opts.parallel_downloads;
+    if (const char *env = g_getenv("COLOSSUS_PARALLEL_DOWNLOADS")) {
+        int v = atoi(env);
+        if (v > 0) n = v;
+    }
+    return std::max(1, std::min(n, MAX_PARALLEL_DOWNLOADS));
+}
+
+static std::string download_cache_dir() {
+    gchar *path = g_build_filename(g_get_user_cache_dir(), "colossus-pkgcenter", "pkg", nullptr);
+    std::string result(path);
+    g_free(path);
+    return result;
+}
+
+static gint64 file_size(const std::string &path) {
+    GStatBuf st;
+    if (g_stat(path.c_str(), &st) != 0) return -1;
+    return static_cast<gint64>(st.st_size);
+}
+
+static std::string format_size(gint64 bytes) {
+    gchar *s = g_format_size(static_cast<guint64>(std::max<gint64>(bytes, 0)));
+    std::string result(s);
+    g_free(s);
+    return result;
+}
+
+enum {
+    DL_COL_FILE = 0,
+    DL_COL_PERCENT,
+    DL_COL_TEXT,
+    DL_N_COLS
+};
+
+class DownloadPipeline : public std::enable_shared_from_this<DownloadPipeline> {
+public:
+    using Ptr = std::shared_ptr<DownloadPipeline>;
+
+    // Resolve `targets` and the dependencies they pull in with `pacman -Sp`,
+    // then fetch whatever is not cached yet. Main thread only.
+    static Ptr start(const std::vector<std::string> &targets) {
+        Ptr pipeline(new DownloadPipeline());
+        pipeline->resolve(targets);
+        return pipeline;
+    }
+
+    ~DownloadPipeline() {
+        if (poll_id_) g_source_remove(poll_id_);
+        close_panel();
+    }
+
+    // Run `fn` once every download has finished or failed (right away if
+    // that has already happened).
+    void when_finished(std::function<void()> fn) {
+        if (finished_) {
+            fn();
+            return;
+        }
+        waiters_.push_back(std::move(fn));
+    }
+
+    // Extra --cachedir arguments for pacman: its own cache first (so that
+    // is where anything we did not fetch still goes), then ours.
+    std::vector<std::string> cachedir_args() const {
+        return { "--cachedir", system_cache_dir_, "--cachedir", cache_dir_ };
+    }
+
+    // pacman does not copy from secondary cache dirs, so once it has
+    // installed them our copies are just clutter.
+    void discard_files() {
+        for (const auto &dl : downloads_) {
+            if (dl.state == Download::DONE) g_unlink(path_for(dl).c_str());
+        }
+    }
+
+private:
+    struct Download {
+        std::string file;
+        std::string url;
+        gint64 size = 0;        // from the sync DB
+        gint64 received = 0;
+        enum State { PENDING, ACTIVE, DONE, FAILED } state = PENDING;
+        GtkTreeIter row;
+    };
+
+    DownloadPipeline() {
+        PacmanOptions opts = read_pacman_options();
+        system_cache_dir_ = opts.cache_dir;
+        concurrency_ = download_concurrency(opts);
+        cache_dir_ = download_cache_dir();
+    }
+
+    std::string path_for(const Download &dl) const {
+        return cache_dir_ + "/" + dl.file;
+    }
+
+    void resolve(const std::vector<std::string> &targets) {
+        std::vector<std::string> argv = {
+            "pacman", "-Sp", "--needed", "--print-format", "%f %s %l"
+        };
+        argv.insert(argv.end(), targets.begin(), targets.end());
+
+        auto listing = std::make_shared<std::string>();
+        Ptr self = shared_from_this();
+
+        ProcessCallbacks callbacks;
+        callbacks.on_stdout = [listing](const char *data, size_t len) {
+            listing->append(data, len);
+        };
+        callbacks.on_stderr = forward_to_stderr("pacman -Sp");
+        callbacks.on_exit = [self, listing](bool) {
+            // Even on failure (e.g. an unknown target) take what was printed;
+            // yay reports the real error later.
+            self->enqueue(*listing);
+            self->pump();
+        };
+        spawn_process(argv, std::move(callbacks));
+    }
+
+    // One "<file> <size> <url>" line per package pacman would download.
+    void enqueue(const std::string &listing) {
+        g_mkdir_with_parents(cache_dir_.c_str(), 0755);
+
+        std::istringstream in(listing);
+        std::string line;
+        while (std::getline(in, line)) {
+            size_t a = line.find(' ');
+            size_t b = a == std::string::npos ? a : line.find(' ', a + 1);
+            if (b == std::string::npos) continue;
+
+            Download dl;
+            dl.file = line.substr(0, a);
+            dl.size = g_ascii_strtoll(line.c_str() + a + 1, nullptr, 10);
+            dl.url = line.substr(b + 1);
+
+            // Local (file://) repos need no download.
+            if (!g_str_has_prefix(dl.url.c_str(), "http") &&
+                !g_str_has_prefix(dl.url.c_str(), "ftp")) {
+                continue;
+            }
+            if (dl.file.find('/') != std::string::npos) continue;
+
+            std::string cached = system_cache_dir_ + "/" + dl.file;
+            if (file_size(cached) == dl.size || file_size(path_for(dl)) == dl.size) continue;
+            downloads_.push_back(std::move(dl));
+        }
+
+        if (!downloads_.empty()) open_panel();
+    }
+
+    void pump() {
+        while (active_ < concurrency_ && next_ < downloads_.size()) {
+            start_download(next_++);
+        }
+        if (active_ == 0 && next_ >= downloads_.size()) finish();
+    }
+
+    void start_download(size_t index) {
+        Download &dl = downloads_[index];
+        dl.state = Download::ACTIVE;
+        active_++;
+
+        std::string part = path_for(dl) + ".part";
+        Ptr self = shared_from_this();
+
+        ProcessCallbacks callbacks;
+        callbacks.on_stderr = forward_to_stderr("download " + dl.file);
+        callbacks.on_exit = [self, index, part](bool ok) {
+            Download &d = self->downloads_[index];
+            if (ok && g_rename(part.c_str(), self->path_for(d).c_str()) == 0) {
+                d.state = Download::DONE;
+                d.received = d.size;
+            } else {
+                g_unlink(part.c_str());
+                d.state = Download::FAILED;
+            }
+            self->active_--;
+            self->update_row(d);
+            self->pump();
+        };
+        spawn_process({ "curl", "-fsSL", "--retry", "2", "-o", part, dl.url },
+                      std::move(callbacks));
+    }
+
+    void finish() {
+        if (finished_) return;
+        finished_ = true;
+
+        if (poll_id_) {
+            g_source_remove(poll_id_);
+            poll_id_ = 0;
+        }
+
+        if (g_status_label && !downloads_.empty()) {
+            size_t failed = 0;
+            gint64 bytes = 0;
+            for (const auto &dl : downloads_) {
+                if (dl.state == Download::FAILED) failed++;
+                else bytes += dl.size;
+            }
+            std::string msg = "Downloaded " + std::to_string(downloads_.size() - failed) +
+                              " packages (" + format_size(bytes) + ")";
+            if (failed) msg += ", " + std::to_string(failed) + " left to pacman";
+            gtk_label_set_text(GTK_LABEL(g_status_label), msg.c_str());
+        }
+        close_panel();
+
+        std::vector<std::function<void()>> waiters;
+        waiters.swap(waiters_);
+        for (auto &fn : waiters) fn();
+    }
+
+    // A small non-modal window: one progress row per file and the overall
+    // throughput. Closing it early only hides the progress.
+    void open_panel() {
+        panel_ = gtk_dialog_new_with_buttons("Downloads", GTK_WINDOW(g_main_window),
+                                             GTK_DIALOG_DESTROY_WITH_PARENT,
+                                             "_Hide", GTK_RESPONSE_CLOSE,
+                                             nullptr);
+        gtk_window_set_default_size(GTK_WINDOW(panel_), 520, 320);
+        g_signal_connect(panel_, "response", G_CALLBACK(gtk_widget_destroy), nullptr);
+        g_signal_connect(panel_, "destroy", G_CALLBACK(on_panel_destroyed), this);
+
+        GtkWidget *content = gtk_dialog_get_content_area(GTK_DIALOG(panel_));
+        gtk_box_set_spacing(GTK_BOX(content), 6);
+
+        summary_ = gtk_label_new("");
+        gtk_label_set_xalign(GTK_LABEL(summary_), 0.0);
+        gtk_box_pack_start(GTK_BOX(content), summary_, FALSE, FALSE, 0);
+
+        store_ = gtk_list_store_new(DL_N_COLS, G_TYPE_STRING, G_TYPE_INT, G_TYPE_STRING);
+        for (auto &dl : downloads_) {
+            gtk_list_store_insert_with_values(store_, &dl.row, -1,
+                                              DL_COL_FILE, dl.file.c_str(),
+                                              DL_COL_PERCENT, 0,
+                                              DL_COL_TEXT, "Waiting",
+                                              -1);
+        }
+
+        GtkWidget *view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(store_));
+        g_object_unref(store_); // the view holds it now
+
+        GtkCellRenderer *text = gtk_cell_renderer_text_new();
+        g_object_set(text, "ellipsize", PANGO_ELLIPSIZE_MIDDLE, nullptr);
+        GtkTreeViewColumn *file_col = gtk_tree_view_column_new_with_attributes(
+            "Package", text, "text", DL_COL_FILE, nullptr);
+        gtk_tree_view_column_set_expand(file_col, TRUE);
+        gtk_tree_view_append_column(GTK_TREE_VIEW(view), file_col);
+
+        GtkCellRenderer *progress = gtk_cell_renderer_progress_new();
+        GtkTreeViewColumn *progress_col = gtk_tree_view_column_new_with_attributes(
+            "Progress", progress, "value", DL_COL_PERCENT, "text", DL_COL_TEXT, nullptr);
+        gtk_tree_view_column_set_min_width(progress_col, 180);
+        gtk_tree_view_append_column(GTK_TREE_VIEW(view), progress_col);
+
+        GtkWidget *scroll = gtk_scrolled_window_new(nullptr, nullptr);
+        gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll),
+                                       GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+        gtk_container_add(GTK_CONTAINER(scroll), view);
+        gtk_box_pack_start(GTK_BOX(content), scroll, TRUE, TRUE, 0);
+
+        gtk_widget_show_all(panel_);
+
+        last_poll_us_ = g_get_monotonic_time();
+        poll_id_ = g_timeout_add(DOWNLOAD_POLL_MS, on_poll, this);
+    }
+
+    void close_panel() {
+        if (!panel_) return;
+        g_signal_handlers_disconnect_by_data(panel_, this);
+        gtk_widget_destroy(panel_);
+        panel_ = nullptr;
+        summary_ = nullptr;
+        store_ = nullptr;
+    }
+
+    static void on_panel_destroyed(GtkWidget *, gpointer data) {
+        auto *self = static_cast<DownloadPipeline *>(data);
+        self->panel_ = nullptr;
+        self->summary_ = nullptr;
+        self->store_ = nullptr;
+    }
+
+    void update_row(const Download &dl) {
+        if (!store_) return;
+
+        std::string text;
+        int percent = 0;
+        switch (dl.state) {
+        case Download::PENDING:
+            text = "Waiting";
+            break;
+        case Download::ACTIVE:
+            percent = dl.size > 0 ? static_cast<int>(std::min<gint64>(100, dl.received * 100 / dl.size)) : 0;
+            text = format_size(dl.received) + " / " + format_size(dl.size);
+            break;
+        case Download::DONE:
+            percent = 100;
+            text = format_size(dl.size);
+            break;
+        case Download::FAILED:
+            text = "Failed";
+            break;
+        }
+        gtk_list_store_set(store_, const_cast<GtkTreeIter *>(&dl.row),
+                           DL_COL_PERCENT, percent,
+                           DL_COL_TEXT, text.c_str(),
+                           -1);
+    }
+
+    // Sizes of the .part files tell us how far each transfer has got.
+    static gboolean on_poll(gpointer data) {
+        auto *self = static_cast<DownloadPipeline *>(data);
+
+        gint64 received = 0;
+        gint64 total = 0;
+        size_t done = 0;
+        for (auto &dl : self->downloads_) {
+            total += dl.size;
+            if (dl.state == Download::ACTIVE) {
+                gint64 now = file_size(self->path_for(dl) + ".part");
+                if (now >= 0) dl.received = now;
+                self->update_row(dl);
+            }
+            if (dl.state == Download::DONE) done++;
+            if (dl.state != Download::FAILED) received += dl.received;
+        }
+
+        // Exponentially smoothed, so the number does not jitter.
+        gint64 now_us = g_get_monotonic_time();
+        double elapsed = static_cast<double>(now_us - self->last_poll_us_) / G_USEC_PER_SEC;
+        if (elapsed > 0) {
+            double rate = static_cast<double>(received - self->last_bytes_) / elapsed;
+            self->rate_ = self->rate_ == 0 ? rate : 0.7 * self->rate_ + 0.3 * rate;
+        }
+        self->last_poll_us_ = now_us;
+        self->last_bytes_ = received;
+
+        if (self->summary_) {
+            std::string msg = std::to_string(done) + " of " + std::to_string(self->downloads_.size()) +
+                              " files, " + format_size(received) + " of " + format_size(total) +
+                              " (" + format_size(static_cast<gint64>(self->rate_)) + "/s, " +
+                              std::to_string(self->concurrency_) + " at a time)";
+            gtk_label_set_text(GTK_LABEL(self->summary_), msg.c_str());
+        }
+        return G_SOURCE_CONTINUE;
+    }
+
+    std::string cache_dir_;
+    std::string system_cache_dir_;
+    int concurrency_ = DEFAULT_PARALLEL_DOWNLOADS;
+
+    std::vector<Download> downloads_;
+    size_t next_ = 0;
+    int active_ = 0;
+    bool finished_ = false;
+    std::vector<std::function<void()>> waiters_;
+
+    guint poll_id_ = 0;
+    gint64 last_poll_us_ = 0;
+    gint64 last_bytes_ = 0;
+    double rate_ = 0;
+
+    GtkWidget *panel_ = nullptr;
+    GtkWidget *summary_ = nullptr;
+    GtkListStore *store_ = nullptr;
+};
+
+// ───────────────────────────────────────────────
+//  AUR builds
+// ───────────────────────────────────────────────
+
+// yay builds AUR packages strictly one after another. For a batch we do it
+// ourselves: fetch each package base, read its .SRCINFO, install missing
+// repo dependencies with one pacman call, then run independent makepkg
+// builds side by side within a core budget. A package another target needs
+// is installed as soon as it is built; the rest go in with one `pacman -U`
+// at the end. What this cannot handle (say, a dependency that only exists
+// in the AUR and is not queued) is handed back to yay.
+static const char *AUR_GIT_URL      = "https://aur.archlinux.org/";
+static const int CORES_PER_BUILD = 4;
+
+static std::string aur_build_dir() {
+    gchar *path = g_build_filename(g_get_user_cache_dir(), "colossus-pkgcenter", "build", nullptr);
+    std::string result(path);
+    g_free(path);
+    return result;
+}
+
+// $COLOSSUS_BUILD_CORES, else every core we have.
+static int build_core_budget() {
+    if (const char *env = g_getenv("COLOSSUS_BUILD_CORES")) {
+        int v = atoi(env);
+        if (v > 0) return v;
+    }
+    return std::max(1, static_cast<int>(g_get_num_processors()));
+}
+
+// "foo>=1.2" -> "foo"
+static std::string dependency_name(const std::string &dep) {
+    size_t end = dep.find_first_of("<>=");
+    return dep.substr(0, end);
+}
+
+// Name -> PackageBase from an AUR RPC "info" reply.
+static void parse_aur_info(const std::string &json,
+                           std::unordered_map<std::string, std::string> &bases) {
+    JsonReader reader(json.data(), json.data() + json.size());
+    if (!reader.consume('{') || reader.consume('}')) return;
+
+    std::string key, value, name, base;
+    do {
+        if (!reader.read_string(key) || !reader.consume(':')) return;
+        if (key != "results") {
+            if (!reader.skip_value()) return;
+            continue;
+        }
+        if (!reader.consume('[')) return;
+        if (reader.consume(']')) continue;
+        do {
+            if (!reader.consume('{')) return;
+            name.clear();
+            base.clear();
+            if (!reader.consume('}')) {
+                do {
+                    if (!reader.read_string(key) || !reader.consume(':')) return;
+                    if (!reader.read_scalar(value)) return;
+                    if (key == "Name") name = value;
+                    else if (key == "PackageBase") base = value;
+                } while (reader.consume(','));
+                if (!reader.consume('}')) return;
+            }
+            if (!name.empty() && !base.empty()) bases[name] = base;
+        } while (reader.consume(','));
+        if (!reader.consume(']')) return;
+    } while (reader.consume(','));
+}
+
+struct AurBuild {
+    std::string base;
+    std::string dir;
+    std::vector<std::string> targets;       // queued names built from this base
+    // (provided name, pkgname) for every split package, itself included.
+    std::vector<std::pair<std::string, std::string>> provides;
+    std::vector<std::string> depends;       // depends, makedepends, checkdepends
+    std::unordered_set<std::string> wanted; // pkgnames to install
+    std::vector<size_t> needed_by;
+    size_t waiting = 0;                     // bases still to be installed first
+    std::vector<std::string> artifacts;
+    enum State { WAITING, BUILDING, BUILT, INSTALLED, FAILED } state = WAITING;
+};
+
+// Fill in pkgnames, provides and dependencies from a .SRCINFO file.
+// Architecture-specific keys (depends_x86_64 = ...) count for `arch` only.
+static bool parse_srcinfo(const std::string &path, const std::string &arch, AurBuild &build) {
+    gchar *contents = nullptr;
+    if (!g_file_get_contents(path.c_str(), &contents, nullptr, nullptr)) return false;
+
+    std::vector<std::string> base_provides;
+    std::vector<std::string> pkgnames;
+    std::vector<std::pair<std::string, std::string>> pkg_provides;
+    std::unordered_set<std::string> seen_deps;
+
+    gchar **lines = g_strsplit(contents, "\n", -1);
+    g_free(contents);
+    for (gchar **it = lines; *it; it++) {
+        gchar *line = g_strstrip(*it);
+        gchar *eq = strstr(line, " = ");
+        if (!eq) continue;
+        *eq = '\0';
+        std::string key(line);
+        std::string value(eq + 3);
+
+        size_t us = key.find('_');
+        if (us != std::string::npos) {
+            if (key.compare(us + 1, std::string::npos, arch) != 0) continue;
+            key.resize(us);
+        }
+
+        if (key == "pkgname") {
+            pkgnames.push_back(value);
+        } else if (key == "provides") {
+            std::string name = dependency_name(value);
+            if (pkgnames.empty()) base_provides.push_back(name);
+            else pkg_provides.emplace_back(name, pkgnames.back());
+        } else if (key == "depends" || key == "makedepends" || key == "checkdepends") {
+            if (seen_deps.insert(value).second) build.depends.push_back(value);
+        }
+    }
+    g_strfreev(lines);
+
+    for (const auto &pkg : pkgnames) {
+        build.provides.emplace_back(pkg, pkg);
+        for (const auto &p : base_provides) build.provides.emplace_back(p, pkg);
+    }
+    build.provides.insert(build.provides.end(), pkg_provides.begin(), pkg_provides.end());
+    return !pkgnames.empty();
+}
+
+// "name-1.2-1-x86_64.pkg.tar.zst" -> "name"
+static std::string artifact_pkgname(const std::string &path) {
+    gchar *file = g_path_get_basename(path.c_str());
+    std::string name(file);
+    g_free(file);
+    for (int i = 0; i < 3; i++) {
+        size_t dash = name.rfind('-');
+        if (dash == std::string::npos) return std::string();
+        name.resize(dash);
+    }
+    return name;
+}
+
+class AurBuildBatch : public std::enable_shared_from_this<AurBuildBatch> {
+public:
+    using Ptr = std::shared_ptr<AurBuildBatch>;
+    // `fallback`: targets that should go through yay instead.
+    using Finished = std::function<void(const std::vector<std::string> &fallback, bool ok)>;
+
+    // `queued`: everything the user asked for in this install, repo
+    // packages included; those are never installed --asdeps.
+    static void run(const std::vector<std::string> &targets, const std::vector<std::string> &queued,
+                    const std::string &password, GtkWidget *dialog, Finished on_done) {
+        Ptr batch(new AurBuildBatch());
+        batch->targets_ = targets;
+        batch->queued_.insert(queued.begin(), queued.end());
+        batch->password_ = password;
+        batch->dialog_ = dialog;
+        batch->on_done_ = std::move(on_done);
+        batch->lookup_bases();
+    }
+
+private:
+    AurBuildBatch() {
+        int budget = build_core_budget();
+        max_builds_ = std::max(1, budget / CORES_PER_BUILD);
+        makeflags_ = "-j" + std::to_string(std::max(1, budget / max_builds_));
+        root_ = aur_build_dir();
+    }
+
+    void status(const std::string &text) {
+        if (dialog_) {
+            gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog_), "%s", text.c_str());
+        }
+    }
+
+    // Give up on scheduling ourselves; yay gets every target not yet installed.
+    void fall_back() {
+        std::vector<std::string> rest;
+        for (const auto &t : targets_) {
+            if (!is_package_installed(t)) rest.push_back(t);
+        }
+        finish(rest);
+    }
+
+    void finish(const std::vector<std::string> &fallback) {
+        bool ok = true;
+        for (const auto &b : builds_) {
+            if (b.state == AurBuild::FAILED) ok = false;
+        }
+        Finished on_done = std::move(on_done_);
+        on_done(fallback, ok);
+    }
+
+    // 1) One RPC call for the package base of every target.
+    void lookup_bases() {
+        status("Looking up AUR packages...");
+
+        Ptr self = shared_from_this();
+        aur_rpc_info(targets_, [self](bool ok, const std::vector<std::string> &replies) {
+            std::unordered_map<std::string, std::string> bases;
+            if (ok) {
+                for (const auto &reply : replies) parse_aur_info(reply, bases);
+            }
+
+            for (const auto &t : self->targets_) {
+                auto it = bases.find(t);
+                if (it == bases.end()) {
+                    self->fall_back();
+                    return;
+                }
+                auto found = std::find_if(self->builds_.begin(), self->builds_.end(),
+                                          [&](const AurBuild &b) { return b.base == it->second; });
+                if (found == self->builds_.end()) {
+                    AurBuild build;
+                    build.base = it->second;
+                    build.dir = self->root_ + "/" + it->second;
+                    self->builds_.push_back(std::move(build));
+                    found = self->builds_.end() - 1;
+                }
+                found->targets.push_back(t);
+                found->wanted.insert(t);
+            }
+            self->fetch_sources();
+        });
+    }
+
+    // 2) Clone (or update) every package base, all at once.
+    void fetch_sources() {
+        status("Fetching build files...");
+        g_mkdir_with_parents(root_.c_str(), 0755);
+
+        auto outstanding = std::make_shared<size_t>(builds_.size());
+        auto failed = std::make_shared<bool>(false);
+        Ptr self = shared_from_this();
+
+        for (const auto &b : builds_) {
+            std::vector<std::string> argv;
+            std::string git_dir = b.dir + "/.git";
+            if (g_file_test(git_dir.c_str(), G_FILE_TEST_IS_DIR)) {
+                argv = { "git", "-C", b.dir, "pull", "--ff-only", "--quiet" };
+            } else {
+                argv = { "git", "clone", "--depth", "1", "--quiet",
+                         std::string(AUR_GIT_URL) + b.base + ".git", b.dir };
+            }
+
+            ProcessCallbacks callbacks;
+            callbacks.on_stderr = forward_to_stderr("git " + b.base, true);
+            callbacks.on_exit = [self, outstanding, failed](bool ok) {
+                if (!ok) *failed = true;
+                if (--*outstanding > 0) return;
+                if (*failed) self->fall_back();
+                else self->plan();
+            };
+            spawn_process(argv, std::move(callbacks));
+        }
+    }
+
+    // 3) Read .SRCINFO and link bases that depend on each other.
+    void plan() {
+        struct utsname uts;
+        std::string arch = uname(&uts) == 0 ? uts.machine : "x86_64";
+
+        for (auto &b : builds_) {
+            if (!parse_srcinfo(b.dir + "/.SRCINFO", arch, b)) {
+                fall_back();
+                return;
+            }
+        }
+
+        std::vector<std::string> external;
+        std::unordered_set<std::string> seen;
+        for (size_t i = 0; i < builds_.size(); i++) {
+            for (const auto &dep : builds_[i].depends) {
+                std::string name = dependency_name(dep);
+                bool internal = false;
+                for (size_t j = 0; j < builds_.size() && !internal; j++) {
+                    if (j == i) continue;
+                    for (const auto &p : builds_[j].provides) {
+                        if (p.first != name) continue;
+                        builds_[j].wanted.insert(p.second);
+                        if (std::find(builds_[j].needed_by.begin(), builds_[j].needed_by.end(), i) ==
+                            builds_[j].needed_by.end()) {
+                            builds_[j].needed_by.push_back(i);
+                            builds_[i].waiting++;
+                        }
+                        internal = true;
+                        break;
+                    }
+                }
+                if (!internal && seen.insert(dep).second) external.push_back(dep);
+            }
+        }
+
+        check_external_deps(external);
+    }
+
+    // 4) `pacman -T` lists what is not satisfied (provides and versions
+    //    included); pacman -S installs it from the repos, or we fall back.
+    //    Build dependencies go in --asdeps, except ones the user queued
+    //    too: those stay explicit, as the later repo install would not
+    //    change a reason already recorded.
+    void check_external_deps(const std::vector<std::string> &deps) {
+        if (deps.empty()) {
+            pump();
+            return;
+        }
+
+        std::vector<std::string> argv = { "pacman", "-T" };
+        argv.insert(argv.end(), deps.begin(), deps.end());
+
+        auto missing = std::make_shared<std::string>();
+        Ptr self = shared_from_this();
+        ProcessCallbacks callbacks;
+        callbacks.on_stdout = [missing](const char *data, size_t len) { missing->append(data, len); };
+        callbacks.on_stderr = forward_to_stderr("pacman -T", true);
+        callbacks.on_exit = [self, missing](bool) {
+            std::vector<std::string> deps, requested;
+            std::istringstream in(*missing);
+            std::string dep;
+            while (std::getline(in, dep)) {
+                if (dep.empty()) continue;
+                (self->queued_.count(dependency_name(dep)) ? requested : deps).push_back(dep);
+            }
+            auto commands = std::make_shared<std::deque<std::vector<std::string>>>();
+            for (const auto *group : { &deps, &requested }) {
+                if (group->empty()) continue;
+                std::vector<std::string> argv = { "sudo", "-S", "pacman", "-S", "--needed", "--noconfirm" };
+                if (group == &deps) argv.push_back("--asdeps");
+                argv.insert(argv.end(), group->begin(), group->end());
+                commands->push_back(std::move(argv));
+            }
+            if (commands->empty()) {
+                self->pump();
+                return;
+            }
+
+            self->status("Installing build dependencies...");
+            self->run_commands(commands, [self](bool ok) {
+                if (ok) self->pump();
+                else self->fall_back();
+            });
+        };
+        spawn_process(argv, std::move(callbacks));
+    }
+
+    // 5) Keep up to max_builds_ makepkg runs going; whenever one ends, the
+    //    next ready base takes its slot.
+    void pump() {
+        for (size_t i = 0; i < builds_.size() && running_ < max_builds_; i++) {
+            if (builds_[i].state == AurBuild::WAITING && builds_[i].waiting == 0) start_build(i);
+        }
+        report_progress();
+
+        if (running_ > 0 || installing_ || !install_queue_.empty()) return;
+
+        // Nothing running: whatever still waits is stuck behind a failed
+        // build or a dependency cycle.
+        for (auto &b : builds_) {
+            if (b.state == AurBuild::WAITING) b.state = AurBuild::FAILED;
+        }
+        install_remaining();
+    }
+
+    void report_progress() {
+        std::string building;
+        size_t done = 0;
+        for (const auto &b : builds_) {
+            if (b.state == AurBuild::BUILDING) building += (building.empty() ? "" : ", ") + b.base;
+            if (b.state == AurBuild::BUILT || b.state == AurBuild::INSTALLED) done++;
+        }
+        if (building.empty()) return;
+        status("Building " + building + " (" + std::to_string(done) + " of " +
+               std::to_string(builds_.size()) + " done, " + makeflags_ + " each)");
+    }
+
+    void start_build(size_t index) {
+        AurBuild &b = builds_[index];
+        b.state = AurBuild::BUILDING;
+        running_++;
+
+        gchar **envp = g_environ_setenv(g_get_environ(), "MAKEFLAGS", makeflags_.c_str(), TRUE);
+        Ptr self = shared_from_this();
+
+        ProcessCallbacks callbacks;
+        callbacks.on_stdout = forward_to_stdout("makepkg " + b.base, true);
+        callbacks.on_stderr = forward_to_stderr("makepkg " + b.base, true);
+        callbacks.on_exit = [self, index](bool ok) {
+            if (ok) {
+                self->collect_artifacts(index);
+            } else {
+                self->running_--;
+                self->fail(index);
+                self->pump();
+            }
+        };
+        spawn_process({ "makepkg", "--noconfirm", "-f" }, std::move(callbacks),
+                      nullptr, b.dir.c_str(), envp);
+        g_strfreev(envp);
+    }
+
+    void fail(size_t index) {
+        if (builds_[index].state == AurBuild::FAILED) return;
+        builds_[index].state = AurBuild::FAILED;
+        for (size_t dependent : builds_[index].needed_by) fail(dependent);
+    }
+
+    // `makepkg --packagelist` names the files a build produced (PKGDEST and
+    // all); keep the ones we want to install.
+    void collect_artifacts(size_t index) {
+        auto listing = std::make_shared<std::string>();
+        Ptr self = shared_from_this();
+
+        ProcessCallbacks callbacks;
+        callbacks.on_stdout = [listing](const char *data, size_t len) { listing->append(data, len); };
+        callbacks.on_stderr = forward_to_stderr("makepkg " + builds_[index].base, true);
+        callbacks.on_exit = [self, index, listing](bool ok) {
+            AurBuild &b = self->builds_[index];
+            self->running_--;
+
+            std::istringstream in(*listing);
+            std::string path;
+            while (std::getline(in, path)) {
+                if (b.wanted.count(artifact_pkgname(path)) &&
+                    g_file_test(path.c_str(), G_FILE_TEST_EXISTS)) {
+                    b.artifacts.push_back(path);
+                }
+            }
+
+            if (!ok || b.artifacts.empty()) {
+                self->fail(index);
+            } else {
+                b.state = AurBuild::BUILT;
+                if (!b.needed_by.empty()) self->install_queue_.push_back(index);
+            }
+            self->install_next();
+            self->pump();
+        };
+        spawn_process({ "makepkg", "--packagelist" }, std::move(callbacks),
+                      nullptr, builds_[index].dir.c_str());
+    }
+
+    // Bases others depend on are installed right away, one pacman at a time.
+    void install_next() {
+        if (installing_ || install_queue_.empty()) return;
+
+        size_t index = install_queue_.front();
+        install_queue_.pop_front();
+        installing_ = true;
+
+        Ptr self = shared_from_this();
+        install_artifacts({ index }, [self, index](bool ok) {
+            self->installing_ = false;
+            if (ok) {
+                self->builds_[index].state = AurBuild::INSTALLED;
+                for (size_t dependent : self->builds_[index].needed_by) {
+                    self->builds_[dependent].waiting--;
+                }
+            } else {
+                self->fail(index);
+            }
+            self->install_next();
+            self->pump();
+        });
+    }
+
+    // 6) Everything else, one pacman -U per install reason.
+    void install_remaining() {
+        std::vector<size_t> built;
+        for (size_t i = 0; i < builds_.size(); i++) {
+            if (builds_[i].state == AurBuild::BUILT) built.push_back(i);
+        }
+        if (built.empty()) {
+            finish({});
+            return;
+        }
+
+        status("Installing built packages...");
+        Ptr self = shared_from_this();
+        install_artifacts(built, [self](bool ok) {
+            for (auto &b : self->builds_) {
+                if (b.state == AurBuild::BUILT) b.state = ok ? AurBuild::INSTALLED : AurBuild::FAILED;
+            }
+            self->finish({});
+        });
+    }
+
+    // pacman -U the artifacts of `indices` the way yay records them: queued
+    // targets --asexplicit, packages only pulled in as dependencies --asdeps
+    // (unless already installed, whose reason a plain -U keeps). Dependencies
+    // go first.
+    void install_artifacts(const std::vector<size_t> &indices, std::function<void(bool)> on_done) {
+        std::vector<std::string> deps, kept, requested;
+        for (size_t index : indices) {
+            const AurBuild &b = builds_[index];
+            for (const auto &path : b.artifacts) {
+                std::string name = artifact_pkgname(path);
+                if (std::find(b.targets.begin(), b.targets.end(), name) != b.targets.end()) {
+                    requested.push_back(path);
+                } else if (!is_package_installed(name)) {
+                    deps.push_back(path);
+                } else {
+                    kept.push_back(path);
+                }
+            }
+        }
+
+        auto commands = std::make_shared<std::deque<std::vector<std::string>>>();
+        auto add = [&](const char *reason, const std::vector<std::string> &paths) {
+            if (paths.empty()) return;
+            std::vector<std::string> argv = { "sudo", "-S", "pacman", "-U", "--noconfirm" };
+            if (reason) argv.push_back(reason);
+            argv.insert(argv.end(), paths.begin(), paths.end());
+            commands->push_back(std::move(argv));
+        };
+        add("--asdeps", deps);
+        add(nullptr, kept);
+        add("--asexplicit", requested);
+        run_commands(commands, std::move(on_done));
+    }
+
+    void run_commands(std::shared_ptr<std::deque<std::vector<std::string>>> commands,
+                      std::function<void(bool)> on_done) {
+        if (commands->empty()) {
+            on_done(true);
+            return;
+        }
+        std::vector<std::string> argv = std::move(commands->front());
+        commands->pop_front();
+        Ptr self = shared_from_this();
+        run_sudo_with_password(password_, argv, [self, commands, on_done](bool ok) {
+            if (ok) self->run_commands(commands, on_done);
+            else on_done(false);
+        });
+    }
+
+    std::vector<std::string> targets_;
+    std::unordered_set<std::string> queued_;
+    std::string password_;
+    GtkWidget *dialog_ = nullptr;
+    Finished on_done_;
+
+    std::string root_;
+    std::string makeflags_;
+    int max_builds_ = 1;
+    int running_ = 0;
+    bool installing_ = false;
+    std::deque<size_t> install_queue_;
+    std::vector<AurBuild> builds_;
+};
+
+// Build and install several AUR targets, from inside a transaction lane
+// entry. `on_done` gets the targets the scheduler could not take, for yay
+// to install.
+static void run_aur_builds(const std::vector<std::string> &targets,
+                           const std::vector<std::string> &queued,
+                           const std::string &password, AurBuildBatch::Finished on_done) {
+    GtkWidget *info = gtk_message_dialog_new(
+        GTK_WINDOW(g_main_window),
+        GTK_DIALOG_MODAL,
+        GTK_MESSAGE_INFO,
+        GTK_BUTTONS_NONE,
+        "Building %zu AUR packages...\n\nThis may take a while.",
+        targets.size()
+    );
+    gtk_widget_show_all(info);
+    g_command_log.begin_file("Building " + std::to_string(targets.size()) + " AUR packages");
+
+    auto finish = [info, on_done](const std::vector<std::string> &fallback, bool ok) {
+        gtk_widget_destroy(info);
+        g_command_log.end_file(ok);
+        refresh_installed_index();
+        update_dependency_graph();
+        on_done(fallback, ok);
+    };
+
+    // Cache sudo credentials first, as for yay.
+    ensure_sudo_session(password, [targets, queued, password, info, finish](bool auth_ok) {
+        if (!auth_ok) {
+            if (g_sudo_password == password) g_sudo_password.clear(); // ask again next time
+            finish({}, false);
+            return;
+        }
+        AurBuildBatch::run(targets, queued, password, info, finish);
+    });
+}
+
+// ───────────────────────────────────────────────
+//  Orphaned packages
+// ───────────────────────────────────────────────
+
+// What an orphan cleanup would remove, worked out from the local DB before
+// anything runs: packages installed as a dependency that no explicitly
+// installed package needs, directly or through other packages, as a hard
+// or an optional dependency. Unneeded chains are found in one pass (a
+// mark from the explicit packages, not repeated `pacman -Qdt` rounds).
+// Dependencies resolve by package name first and then through provides.
+
+struct LocalPackage {
+    std::string name;
+    std::string version;
+    bool as_dependency = false;           // %REASON% 1
+    guint64 size = 0;                     // installed size
+    std::vector<std::string> depends;     // names, version constraints stripped
+    std::vector<std::string> optdepends;
+    std::vector<std::string> provides;
+};
+
+// A local DB "desc" file: %SECTION% lines, each followed by its values.
+static void parse_local_desc(const std::string &text, LocalPackage &pkg) {
+    std::istringstream in(text);
+    std::string line, section;
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            section.clear();
+        } else if (line.size() > 1 && line.front() == '%' && line.back() == '%') {
+            section = line;
+        } else if (section == "%NAME%") {
+            pkg.name = line;
+        } else if (section == "%VERSION%") {
+            pkg.version = line;
+        } else if (section == "%SIZE%") {
+            pkg.size = g_ascii_strtoull(line.c_str(), nullptr, 10);
+        } else if (section == "%REASON%") {
+            pkg.as_dependency = line == "1";
+        } else if (section == "%DEPENDS%") {
+            pkg.depends.push_back(dependency_name(line));
+        } else if (section == "%OPTDEPENDS%") {
+            pkg.optdepends.push_back(dependency_name(line.substr(0, line.find(':')))); // "name: why"
+        } else if (section == "%PROVIDES%") {
+            pkg.provides.push_back(dependency_name(line));
+        }
+    }
+}
+
+#ifdef COLOSSUS_WITH_ALPM
+static void alpm_dependency_names(alpm_list_t *list, std::vector<std::string> &out) {
+    for (alpm_list_t *it = list; it; it = it->next) {
+        out.push_back(static_cast<alpm_depend_t *>(it->data)->name);
+    }
+}
+
+static bool alpm_read_local_packages(std::vector<LocalPackage> &out) {
+    alpm_handle_t *handle = open_alpm_handle();
+    if (!handle) return false;
+
+    alpm_db_t *local = alpm_get_localdb(handle);
+    for (alpm_list_t *it = alpm_db_get_pkgcache(local); it; it = it->next) {
+        auto *pkg = static_cast<alpm_pkg_t *>(it->data);
+        LocalPackage lp;
+        lp.name = alpm_pkg_get_name(pkg);
+        lp.version = alpm_pkg_get_version(pkg);
+        lp.as_dependency = alpm_pkg_get_reason(pkg) == ALPM_PKG_REASON_DEPEND;
+        lp.size = static_cast<guint64>(std::max<long long>(alpm_pkg_get_isize(pkg), 0));
+        alpm_dependency_names(alpm_pkg_get_depends(pkg), lp.depends);
+        alpm_dependency_names(alpm_pkg_get_optdepends(pkg), lp.optdepends);
+        alpm_dependency_names(alpm_pkg_get_provides(pkg), lp.provides);
+        out.push_back(std::move(lp));
+    }
+    alpm_release(handle);
+    return true;
+}
+#endif
+
+// One local DB entry ("<name>-<pkgver>-<pkgrel>") from its desc file.
+static bool read_local_package(const char *entry, LocalPackage &pkg) {
+    gchar *path = g_build_filename(PACMAN_LOCAL_DB, entry, "desc", nullptr);
+    gchar *text = nullptr;
+    gsize len = 0;
+    bool ok = g_file_get_contents(path, &text, &len, nullptr);
+    if (ok) {
+        parse_local_desc(std::string(text, len), pkg);
+        g_free(text);
+    }
+    g_free(path);
+    return ok && !pkg.name.empty();
+}
+
+// Every installed package with what the cleanup needs to know about it.
+// Worker thread.
+static bool read_local_packages(std::vector<LocalPackage> &out) {
+#ifdef COLOSSUS_WITH_ALPM
+    if (alpm_read_local_packages(out)) return true;
+    out.clear();
+#endif
+
+    GDir *dir = g_dir_open(PACMAN_LOCAL_DB, 0, nullptr);
+    if (!dir) return false;
+    const gchar *entry;
+    while ((entry = g_dir_read_name(dir)) != nullptr) {
+        LocalPackage pkg;
+        if (read_local_package(entry, pkg)) out.push_back(std::move(pkg));
+    }
+    g_dir_close(dir);
+    return true;
+}
+
+// The orphans, by name, and for each one the other orphans it depends on
+// (hard or optional), so a selection can be kept consistent.
+struct OrphanSet {
+    std::vector<LocalPackage> packages;
+    std::vector<std::vector<uint32_t>> needs;
+};
+
+static OrphanSet find_orphans(std::vector<LocalPackage> pkgs) {
+    TraceScope trace("find orphans");
+    std::sort(pkgs.begin(), pkgs.end(),
+              [](const LocalPackage &a, const LocalPackage &b) { return a.name < b.name; });
+
+    std::unordered_map<std::string, uint32_t> by_name;
+    std::unordered_map<std::string, std::vector<uint32_t>> providers;
+    for (uint32_t i = 0; i < pkgs.size(); i++) {
+        by_name[pkgs[i].name] = i;
+        for (const auto &p : pkgs[i].provides) providers[p].push_back(i);
+    }
+    auto resolve = [&](const std::string &dep, auto &&fn) {
+        auto named = by_name.find(dep);
+        if (named != by_name.end()) {
+            fn(named->second);
+            return;
+        }
+        auto provided = providers.find(dep);
+        if (provided == providers.end()) return;
+        for (uint32_t j : provided->second) fn(j);
+    };
+
+    // Mark everything reachable from the explicitly installed packages.
+    std::vector<bool> kept(pkgs.size(), false);
+    std::vector<uint32_t> stack;
+    for (uint32_t i = 0; i < pkgs.size(); i++) {
+        if (!pkgs[i].as_dependency) {
+            kept[i] = true;
+            stack.push_back(i);
+        }
+    }
+    auto mark = [&](uint32_t j) {
+        if (kept[j]) return;
+        kept[j] = true;
+        stack.push_back(j);
+    };
+    while (!stack.empty()) {
+        uint32_t i = stack.back();
+        stack.pop_back();
+        for (const auto &dep : pkgs[i].depends) resolve(dep, mark);
+        for (const auto &dep : pkgs[i].optdepends) resolve(dep, mark);
+    }
+
+    OrphanSet set;
+    std::vector<uint32_t> slot(pkgs.size(), UINT32_MAX);
+    uint32_t orphans = 0;
+    for (uint32_t i = 0; i < pkgs.size(); i++) {
+        if (!kept[i]) slot[i] = orphans++;
+    }
+    set.needs.resize(orphans);
+    for (uint32_t i = 0; i < pkgs.size(); i++) {
+        if (kept[i]) continue;
+        auto &needs = set.needs[slot[i]];
+        auto link = [&](uint32_t j) {
+            if (j != i && slot[j] != UINT32_MAX) needs.push_back(slot[j]);
+        };
+        for (const auto &dep : pkgs[i].depends) resolve(dep, link);
+        for (const auto &dep : pkgs[i].optdepends) resolve(dep, link);
+        set.packages.push_back(std::move(pkgs[i]));
+    }
+    return set;
+}
+
+// ───────────────────────────────────────────────
+//  Dependency graph
+// ───────────────────────────────────────────────
+
+// The installed packages and their dependencies, resolved through
+// provides once, in CSR form (an offsets array into one flat array of
+// indices per relation), so a removal preview is a short walk over
+// integers. Graphs are immutable: a change to the local DB builds a new
+// one off the main thread, rereading only the desc files of entries that
+// are new since the last graph, and swaps it in.
+// A desc file's mtime (ns) and size. `pacman -D --asdeps` and same-version
+// reinstalls rewrite it under an unchanged entry name.
+struct DescStamp {
+    gint64 mtime = -1;
+    gint64 size = -1;
+    bool operator==(const DescStamp &o) const { return mtime == o.mtime && size == o.size; }
+};
+
+static DescStamp desc_stamp(const char *entry) {
+    DescStamp stamp;
+    gchar *path = g_build_filename(PACMAN_LOCAL_DB, entry, "desc", nullptr);
+    struct stat st;
+    if (stat(path, &st) == 0) {
+        stamp.mtime = static_cast<gint64>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+        stamp.size = static_cast<gint64>(st.st_size);
+    }
+    g_free(path);
+    return stamp;
+}
+
+struct DependencyGraph {
+    std::vector<LocalPackage> packages;   // by name
+    std::vector<std::string> entries;     // local DB directory of each
+    std::vector<DescStamp> stamps;        // and its desc file when read
+    std::unordered_map<std::string, uint32_t> by_name;
+
+    // Package i's hard dependencies are slots dep_offsets[i] .. dep_offsets[i+1];
+    // slot s is satisfied by providers[slot_offsets[s] .. slot_offsets[s+1]].
+    std::vector<uint32_t> dep_offsets, slot_offsets, providers;
+    // Who has package i as a hard / optional dependency.
+    std::vector<uint32_t> rdep_offsets, required_by;
+    std::vector<uint32_t> ropt_offsets, optional_for;
+};
+
+using DependencyGraphPtr = std::shared_ptr<const DependencyGraph>;
+
+// Main thread only.
+static DependencyGraphPtr g_dependency_graph;
+static bool g_dependency_graph_updating = false;
+static bool g_dependency_graph_stale = false;   // changed again meanwhile
+
+// Reverse of the edges `fn(i, add)` produces for each package i: for each
+// package j, the distinct i with an edge i -> j.
+template <typename Fn>
+static void build_reverse_csr(size_t n, Fn &&fn, std::vector<uint32_t> &offsets,
+                              std::vector<uint32_t> &edges) {
+    std::vector<uint32_t> last(n, UINT32_MAX);   // dedupe per source
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    for (uint32_t i = 0; i < n; i++) {
+        fn(i, [&](uint32_t j) {
+            if (j == i || last[j] == i) return;
+            last[j] = i;
+            pairs.emplace_back(j, i);
+        });
+    }
+    offsets.assign(n + 1, 0);
+    for (const auto &p : pairs) offsets[p.first + 1]++;
+    for (size_t j = 0; j < n; j++) offsets[j + 1] += offsets[j];
+    edges.resize(pairs.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (const auto &p : pairs) edges[fill[p.first]++] = p.second;
+}
+
+static DependencyGraphPtr build_dependency_graph(std::vector<LocalPackage> pkgs,
+                                                 std::vector<std::string> entries,
+                                                 std::vector<DescStamp> stamps) {
+    TraceScope trace("build dependency graph");
+    auto graph = std::make_shared<DependencyGraph>();
+    DependencyGraph &g = *graph;
+    size_t n = pkgs.size();
+
+    std::vector<uint32_t> order(n);
+    for (uint32_t i = 0; i < n; i++) order[i] = i;
+    std::sort(order.begin(), order.end(),
+              [&pkgs](uint32_t a, uint32_t b) { return pkgs[a].name < pkgs[b].name; });
+    g.packages.reserve(n);
+    g.entries.reserve(n);
+    g.stamps.reserve(n);
+    for (uint32_t i : order) {
+        g.packages.push_back(std::move(pkgs[i]));
+        g.entries.push_back(std::move(entries[i]));
+        g.stamps.push_back(stamps[i]);
+    }
+
+    std::unordered_map<std::string, std::vector<uint32_t>> provided;
+    for (uint32_t i = 0; i < n; i++) {
+        g.by_name[g.packages[i].name] = i;
+        for (const auto &p : g.packages[i].provides) provided[p].push_back(i);
+    }
+    // A name is satisfied by the package of that name, else by whatever
+    // provides it; nothing when it is not installed at all.
+    auto resolve = [&](const std::string &dep, auto &&fn) {
+        auto named = g.by_name.find(dep);
+        if (named != g.by_name.end()) {
+            fn(named->second);
+            return;
+        }
+        auto it = provided.find(dep);
+        if (it == provided.end()) return;
+        for (uint32_t j : it->second) fn(j);
+    };
+
+    g.dep_offsets.reserve(n + 1);
+    g.slot_offsets.push_back(0);
+    for (uint32_t i = 0; i < n; i++) {
+        g.dep_offsets.push_back(static_cast<uint32_t>(g.slot_offsets.size() - 1));
+        for (const auto &dep : g.packages[i].depends) {
+            resolve(dep, [&](uint32_t j) { g.providers.push_back(j); });
+            g.slot_offsets.push_back(static_cast<uint32_t>(g.providers.size()));
+        }
+    }
+    g.dep_offsets.push_back(static_cast<uint32_t>(g.slot_offsets.size() - 1));
+
+    build_reverse_csr(n, [&](uint32_t i, auto &&add) {
+        for (uint32_t k = g.slot_offsets[g.dep_offsets[i]]; k < g.slot_offsets[g.dep_offsets[i + 1]]; k++) {
+            add(g.providers[k]);
+        }
+    }, g.rdep_offsets, g.required_by);
+    build_reverse_csr(n, [&](uint32_t i, auto &&add) {
+        for (const auto &dep : g.packages[i].optdepends) resolve(dep, add);
+    }, g.ropt_offsets, g.optional_for);
+    return graph;
+}
+
+// Worker thread. Packages whose entry `previous` already knows, with its
+// desc file unchanged (mtime and size), are taken from it; the rest are
+// read from their desc files.
+static DependencyGraphPtr load_dependency_graph(const DependencyGraph *previous) {
+    std::unordered_map<std::string, uint32_t> known;
+    if (previous) {
+        for (uint32_t i = 0; i < previous->entries.size(); i++) known[previous->entries[i]] = i;
+    }
+
+    std::vector<LocalPackage> pkgs;
+    std::vector<std::string> entries;
+    std::vector<DescStamp> stamps;
+    GDir *dir = g_dir_open(PACMAN_LOCAL_DB, 0, nullptr);
+    if (!dir) {
+        // Somewhere else (or only reachable through libalpm): read it all.
+        if (!read_local_packages(pkgs)) return nullptr;
+        entries.resize(pkgs.size());
+        stamps.resize(pkgs.size());
+        return build_dependency_graph(std::move(pkgs), std::move(entries), std::move(stamps));
+    }
+    const gchar *entry;
+    while ((entry = g_dir_read_name(dir)) != nullptr) {
+        DescStamp stamp = desc_stamp(entry);
+        auto it = known.find(entry);
+        if (it != known.end() && stamp.mtime >= 0 && previous->stamps[it->second] == stamp) {
+            pkgs.push_back(previous->packages[it->second]);
+        } else {
+            LocalPackage pkg;
+            if (!read_local_package(entry, pkg)) continue;   // ALPM_DB_VERSION and the like
+            pkgs.push_back(std::move(pkg));
+        }
+        entries.emplace_back(entry);
+        stamps.push_back(stamp);
+    }
+    g_dir_close(dir);
+    return build_dependency_graph(std::move(pkgs), std::move(entries), std::move(stamps));
+}
+
+// Bring g_dependency_graph up to date with the local DB. Cheap to call
+// often: at most one update runs, and calls meanwhile fold into one more.
+static void update_dependency_graph() {
+    if (g_dependency_graph_updating) {
+        g_dependency_graph_stale = true;
+        return;
+    }
+    g_dependency_graph_updating = true;
+
+    DependencyGraphPtr previous = g_dependency_graph;
+    auto next = std::make_shared<DependencyGraphPtr>();
+    auto job = std::make_shared<Job>();
+    job->work = [previous, next](Job &) { *next = load_dependency_graph(previous.get()); };
+    job->finished = [next](Job &job) {
+        g_dependency_graph_updating = false;
+        if (!job.cancelled && *next) g_dependency_graph = *next;
+        if (g_dependency_graph_stale) {
+            g_dependency_graph_stale = false;
+            update_dependency_graph();
+        }
+    };
+    g_index_jobs->submit(job);
+}
+
+struct RemovalImpact {
+    std::vector<uint32_t> removed;    // the targets, then what goes with them
+    std::vector<uint32_t> breaks;     // stay installed but lose a hard dependency
+    std::vector<uint32_t> optional;   // stay installed and lose an optional one
+    guint64 size = 0;
+};
+
+// What `pacman -Rs` (yay -Rns) would do with `targets`: take along every
+// dependency installed as one that only removed packages need, until
+// nothing else qualifies.
+static RemovalImpact removal_impact(const DependencyGraph &g, const std::vector<uint32_t> &targets) {
+    TraceScope trace("removal impact");
+    RemovalImpact impact;
+    std::vector<bool> removed(g.packages.size(), false);
+    for (uint32_t t : targets) {
+        if (removed[t]) continue;
+        removed[t] = true;
+        impact.removed.push_back(t);
+    }
+
+    auto only_needed_by_removed = [&](uint32_t p) {
+        for (uint32_t k = g.rdep_offsets[p]; k < g.rdep_offsets[p + 1]; k++) {
+            if (!removed[g.required_by[k]]) return false;
+        }
+        return true;
+    };
+    // A dependency can qualify only once a later one has been taken, so
+    // go over the whole set again until a pass adds nothing. Like pacman,
+    // follow a dependency to its first satisfier only (providers are in
+    // name order), not to every package that also provides it.
+    for (bool grew = true; grew;) {
+        grew = false;
+        for (size_t r = 0; r < impact.removed.size(); r++) {
+            uint32_t i = impact.removed[r];
+            for (uint32_t s = g.dep_offsets[i]; s < g.dep_offsets[i + 1]; s++) {
+                if (g.slot_offsets[s] == g.slot_offsets[s + 1]) continue;   // not installed
+                uint32_t p = g.providers[g.slot_offsets[s]];
+                if (removed[p] || !g.packages[p].as_dependency || !only_needed_by_removed(p)) continue;
+                removed[p] = true;
+                impact.removed.push_back(p);
+                grew = true;
+            }
+        }
+    }
+
+    // A dependent breaks when a dependency of its loses every provider.
+    std::vector<bool> listed(g.packages.size(), false);
+    for (uint32_t i : impact.removed) {
+        impact.size += g.packages[i].size;
+        for (uint32_t k = g.rdep_offsets[i]; k < g.rdep_offsets[i + 1]; k++) {
+            uint32_t d = g.required_by[k];
+            if (removed[d] || listed[d]) continue;
+            for (uint32_t s = g.dep_offsets[d]; s < g.dep_offsets[d + 1]; s++) {
+                bool satisfied = false, involved = false;
+                for (uint32_t k2 = g.slot_offsets[s]; k2 < g.slot_offsets[s + 1]; k2++) {
+                    if (removed[g.providers[k2]]) involved = true;
+                    else satisfied = true;
+                }
+                if (involved && !satisfied) {
+                    listed[d] = true;
+                    impact.breaks.push_back(d);
+                    break;
+                }
+            }
+        }
+    }
+    for (uint32_t i : impact.removed) {
+        for (uint32_t k = g.ropt_offsets[i]; k < g.ropt_offsets[i + 1]; k++) {
+            uint32_t d = g.optional_for[k];
+            if (removed[d] || listed[d]) continue;
+            listed[d] = true;
+            impact.optional.push_back(d);
+        }
+    }
+    return impact;
+}
+
+// "a, b, c and 4 more"
+static std::string package_name_list(const DependencyGraph &g, const std::vector<uint32_t> &pkgs,
+                                     size_t first, size_t limit = 12) {
+    std::string out;
+    size_t end = std::min(pkgs.size(), first + limit);
+    for (size_t i = first; i < end; i++) {
+        if (!out.empty()) out += ", ";
+        out += g.packages[pkgs[i]].name;
+    }
+    if (pkgs.size() > end) out += " and " + std::to_string(pkgs.size() - end) + " more";
+    return out;
+}
+
+// The remove dialog's explanation of `impact` for `targets` targets.
+static std::string describe_removal(const DependencyGraph &g, const RemovalImpact &impact,
+                                    size_t targets) {
+    std::string text;
+    size_t extra = impact.removed.size() - targets;
+    if (extra == 0) {
+        text = "No other packages will be removed.";
+    } else {
+        text = "Also removes " + std::to_string(extra) +
+               (extra == 1 ? " unused dependency: " : " unused dependencies: ") +
+               package_name_list(g, impact.removed, targets) + ".";
+    }
+    text += "\nFrees " + format_size(static_cast<gint64>(impact.size)) + ".";
+    if (!impact.breaks.empty()) {
+        text += "\n\nRequired by " + package_name_list(g, impact.breaks, 0) +
+                ": the removal will fail unless " +
+                (impact.breaks.size() == 1 ? "it is" : "they are") + " removed too.";
+    }
+    if (!impact.optional.empty()) {
+        text += "\n\nOptional for " + package_name_list(g, impact.optional, 0) + ".";
+    }
+    return text;
+}
+
+// ───────────────────────────────────────────────
+//  Install / Remove / Clean handlers
+// ───────────────────────────────────────────────
+
+// A transaction only changes what is installed, not what a search finds,
+// so just flip the affected rows instead of searching again.
+static void refresh_after_transaction() {
+    if (g_results.empty()) {
+        if (g_status_label)
+            gtk_label_set_text(GTK_LABEL(g_status_label), "Ready. Enter a search term.");
+        return;
+    }
+    refresh_installed_flags();
+}
+
+// Refuse to start a second privileged operation while one is running.
+static bool transaction_lane_available() {
+    if (g_transactions.busy()) {
         GtkWidget *warn = gtk_message_dialog_new(
             GTK_WINDOW(g_main_window),
             GTK_DIALOG_MODAL,
-            GTK_MESSAGE_ERROR,
+            GTK_MESSAGE_WARNING,
+            GTK_BUTTONS_OK,
+            "Another operation is still running.\nPlease wait for it to finish."
+        );
+        gtk_dialog_run(GTK_DIALOG(warn));
+        gtk_widget_destroy(warn);
+        return false;
+    }
+    return true;
+}
+
+// Ask for the sudo password the first time an operation is about to start:
+// after its confirmation or preview was accepted, so nothing asks for it
+// only to find there is nothing to do.
+static bool sudo_password_available() {
+    if (g_sudo_password.empty()) prompt_for_sudo_password();
+    return !g_sudo_password.empty();
+}
+
+// Show the last complete line of a child's output as the dialog's
+// secondary text, so a long yay run visibly makes progress. `pending`
+// carries the unfinished line between chunks.
+static void show_latest_output_line(GtkWidget *dialog, std::string &pending,
+                                    const char *data, size_t len) {
+    pending.append(data, len);
+
+    std::string line;
+    size_t start = 0;
+    size_t eol;
+    while ((eol = pending.find_first_of("\r\n", start)) != std::string::npos) {
+        if (eol > start) line.assign(pending, start, eol - start);
+        start = eol + 1;
+    }
+    pending.erase(0, start);
+    line = strip_ansi_and_osc(line);
+
+    if (!line.empty() && g_utf8_validate(line.c_str(), -1, nullptr)) {
+        gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog), "%s", line.c_str());
+    }
+}
+
+// Pre-authenticate sudo and run `argv`, from inside a transaction lane
+// entry (see start_transaction). While it runs, a modal "please wait"
+// dialog shows `info_text` and the latest line of yay's output; it is
+// destroyed before `on_done` runs. With `sudo_stdin`, `argv` is a
+// `sudo -S ...` command and gets the password on stdin in case the cached
+// credentials ran out.
+static void run_transaction(const std::vector<std::string> &argv, const std::string &password,
+                            const std::string &info_text, std::function<void(bool ok)> on_done,
+                            bool sudo_stdin = false) {
+    gint64 started = trace_start();
+    GtkWidget *info = gtk_message_dialog_new(
+        GTK_WINDOW(g_main_window),
+        GTK_DIALOG_MODAL,
+        GTK_MESSAGE_INFO,
+        GTK_BUTTONS_NONE,
+        "%s\n\nThis may take a moment.",
+        info_text.c_str()
+    );
+    gtk_widget_show_all(info);
+
+    std::string command;
+    for (const auto &arg : argv) command += (command.empty() ? "" : " ") + arg;
+    g_command_log.begin_file(info_text + "  $ " + command);
+
+    auto finish = [info, on_done, started, info_text](bool ok) {
+        gtk_widget_destroy(info);
+        trace_record("transaction", started, info_text);
+        g_command_log.end_file(ok);
+
+        // Installed set changed (or might have, even on failure).
+        refresh_installed_index();
+        update_dependency_graph();
+
+        on_done(ok);
+    };
+
+    // 1) Pre-authenticate sudo (cache credentials for the user), once per
+    //    session; see ensure_sudo_session.
+    ensure_sudo_session(password, [argv, password, sudo_stdin, info, finish](bool auth_ok) {
+        if (!auth_ok) {
+            if (g_sudo_password == password) g_sudo_password.clear(); // ask again next time
+            finish(false);
+            return;
+        }
+
+        // 2) Run yay as the NORMAL USER (no sudo here!)
+        //    yay will call sudo pacman internally, which will reuse the cached credentials.
+        ProcessCallbacks callbacks;
+        auto pending = std::make_shared<std::string>();
+        ChunkCallback forward = forward_to_stdout(argv[0], true);
+        callbacks.on_stdout = [info, pending, forward](const char *data, size_t len) {
+            forward(data, len);
+            show_latest_output_line(info, *pending, data, len);
+        };
+        callbacks.on_stderr = forward_to_stderr(argv[0], true);
+        callbacks.on_exit = finish;
+        std::string pwline = password + "\n";
+        spawn_process(argv, std::move(callbacks), sudo_stdin ? &pwline : nullptr);
+    });
+}
+
+// run_transaction() as an entry of its own on the transaction lane.
+static void start_transaction(const std::vector<std::string> &argv, const std::string &info_text,
+                              std::function<void(bool ok)> on_done, bool sudo_stdin = false) {
+    std::string password = g_sudo_password;
+    g_transactions.submit([argv, password, info_text, on_done, sudo_stdin](std::function<void()> done) {
+        run_transaction(argv, password, info_text, [on_done, done](bool ok) {
+            on_done(ok);
+            done();
+        }, sudo_stdin);
+    });
+}
+
+static std::vector<std::string> yay_install_argv(const std::vector<std::string> &names,
+                                                 const std::vector<std::string> &extra = {}) {
+    std::vector<std::string> argv = {
+        "yay", "-S", "--noconfirm",
+        "--answerclean", "None",
+        "--answerdiff", "None",
+        "--answeredit", "None",
+    };
+    argv.insert(argv.end(), extra.begin(), extra.end());
+    argv.insert(argv.end(), names.begin(), names.end());
+    return argv;
+}
+
+// True if the catalog has `name` in a sync repo. Without a catalog nothing
+// is, and installs are left to yay entirely, as before.
+static bool is_sync_package(const std::string &name) {
+    if (!g_catalog) return false;
+
+    std::string folded(name);
+    for (char &c : folded) c = fold_ascii(c);
+    for (uint32_t id : g_catalog->search({ folded })) {
+        const CatalogRecord &rec = g_catalog->records[id];
+        if (g_catalog->repos[rec.repo] != AUR_REPO_NAME &&
+            g_catalog->str(rec.name_off, rec.name_len) == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static std::string install_text(const std::vector<std::string> &names, const char *verb) {
+    if (names.size() == 1) return std::string(verb) + " " + names[0] + "...";
+    return std::string(verb) + " " + std::to_string(names.size()) + " packages...";
+}
+
+// Install `names`. AUR packages go on the transaction lane first; the repo
+// packages start downloading right away, in parallel, and are installed
+// from those files once both the AUR builds and the downloads are done.
+// `on_done` runs once per group with the names in that group.
+static void start_install(const std::vector<std::string> &names,
+                          std::function<void(const std::vector<std::string> &, bool ok)> on_done) {
+    std::vector<std::string> repo;
+    std::vector<std::string> aur;
+    for (const auto &name : names) {
+        (is_sync_package(name) ? repo : aur).push_back(name);
+    }
+
+    DownloadPipeline::Ptr prefetch;
+    if (!repo.empty()) prefetch = DownloadPipeline::start(repo);
+
+    // yay builds one package after another; several go to our scheduler,
+    // which hands back anything it cannot build by itself. The batch and
+    // that yay run share one lane entry, so both come before the repo
+    // install queued below.
+    if (aur.size() > 1) {
+        std::string password = g_sudo_password;
+        g_transactions.submit([aur, names, password, on_done](std::function<void()> done) {
+            run_aur_builds(aur, names, password,
+                           [aur, password, on_done, done](const std::vector<std::string> &fallback, bool ok) {
+                if (fallback.empty()) {
+                    on_done(aur, ok);
+                    done();
+                    return;
+                }
+                run_transaction(yay_install_argv(fallback), password, install_text(fallback, "Building"),
+                                [aur, ok, on_done, done](bool yay_ok) {
+                    on_done(aur, ok && yay_ok);
+                    done();
+                });
+            });
+        });
+    } else if (!aur.empty()) {
+        start_transaction(yay_install_argv(aur), install_text(aur, "Building"),
+                          [aur, on_done](bool ok) { on_done(aur, ok); });
+    }
+
+    if (!repo.empty()) {
+        g_transactions.submit([prefetch](std::function<void()> done) {
+            prefetch->when_finished(std::move(done));
+        });
+        start_transaction(yay_install_argv(repo, prefetch->cachedir_args()),
+                          install_text(repo, "Installing"),
+                          [repo, prefetch, on_done](bool ok) {
+            if (ok) prefetch->discard_files();
+            on_done(repo, ok);
+        });
+    }
+}
+
+extern "C" void on_install_clicked(GtkWidget *button, gpointer user_data) {
+    (void)button;
+    const char *pkg_name_c = static_cast<const char *>(user_data);
+    if (!pkg_name_c) return;
+
+    std::string pkg_name(pkg_name_c);
+
+    if (!transaction_lane_available()) return;
+
+    GtkWidget *dialog = gtk_message_dialog_new(
+        GTK_WINDOW(g_main_window),
+        GTK_DIALOG_MODAL,
+        GTK_MESSAGE_QUESTION,
+        GTK_BUTTONS_OK_CANCEL,
+        "Install package \"%s\" using yay?",
+        pkg_name.c_str()
+    );
+    gint response = gtk_dialog_run(GTK_DIALOG(dialog));
+    gtk_widget_destroy(dialog);
+
+    if (response != GTK_RESPONSE_OK || !sudo_password_available()) {
+        return;
+    }
+
+    if (g_status_label) {
+        std::string msg = "Installing " + pkg_name + "...";
+        gtk_label_set_text(GTK_LABEL(g_status_label), msg.c_str());
+    }
+
+    start_install({ pkg_name }, [](const std::vector<std::string> &, bool ok) {
+        GtkWidget *done = gtk_message_dialog_new(
+            GTK_WINDOW(g_main_window),
+            GTK_DIALOG_MODAL,
+            ok ? GTK_MESSAGE_INFO : GTK_MESSAGE_ERROR,
+            GTK_BUTTONS_OK,
+            ok ?
+              "Installation finished.\nRe-run the search to see the updated status." :
+              "Installation may have failed.\nCheck the command log or run yay manually."
+        );
+        if (!ok) show_log_hint(done);
+        gtk_dialog_run(GTK_DIALOG(done));
+        gtk_widget_destroy(done);
+
+        refresh_after_transaction();
+    });
+}
+
+extern "C" void on_remove_clicked(GtkWidget *button, gpointer user_data) {
+    (void)button;
+    const char *pkg_name_c = static_cast<const char *>(user_data);
+    if (!pkg_name_c) return;
+
+    std::string pkg_name(pkg_name_c);
+
+    if (!transaction_lane_available()) return;
+
+    // Until the graph is first built, only the general warning.
+    std::string details = "This will also remove unused dependencies.";
+    bool breaks = false;
+    if (g_dependency_graph) {
+        auto it = g_dependency_graph->by_name.find(pkg_name);
+        if (it != g_dependency_graph->by_name.end()) {
+            RemovalImpact impact = removal_impact(*g_dependency_graph, { it->second });
+            details = describe_removal(*g_dependency_graph, impact, 1);
+            breaks = !impact.breaks.empty();
+        }
+    }
+
+    GtkWidget *dialog = gtk_message_dialog_new(
+        GTK_WINDOW(g_main_window),
+        GTK_DIALOG_MODAL,
+        breaks ? GTK_MESSAGE_WARNING : GTK_MESSAGE_QUESTION,
+        GTK_BUTTONS_OK_CANCEL,
+        "Remove package \"%s\"?",
+        pkg_name.c_str()
+    );
+    gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog), "%s", details.c_str());
+    gint response = gtk_dialog_run(GTK_DIALOG(dialog));
+    gtk_widget_destroy(dialog);
+
+    if (response != GTK_RESPONSE_OK || !sudo_password_available()) {
+        return;
+    }
+
+    if (g_status_label) {
+        std::string msg = "Removing " + pkg_name + "...";
+        gtk_label_set_text(GTK_LABEL(g_status_label), msg.c_str());
+    }
+
+    std::string info_text = "Removing " + pkg_name + "...";
+
+    // Remove package and unused dependencies.
+    std::vector<std::string> argv = { "yay", "-Rns", "--noconfirm", pkg_name };
+
+    start_transaction(argv, info_text, [](bool ok) {
+        GtkWidget *done = gtk_message_dialog_new(
+            GTK_WINDOW(g_main_window),
+            GTK_DIALOG_MODAL,
+            ok ? GTK_MESSAGE_INFO : GTK_MESSAGE_ERROR,
+            GTK_BUTTONS_OK,
+            ok ?
+              "Removal finished.\nRe-run the search to see the updated status." :
+              "Removal may have failed.\nCheck the command log or run yay manually."
+        );
+        if (!ok) show_log_hint(done);
+        gtk_dialog_run(GTK_DIALOG(done));
+        gtk_widget_destroy(done);
+
+        refresh_after_transaction();
+    });
+}
+
+// Without a readable local DB there is nothing to preview: leave it to yay.
+static void clean_orphans_with_yay() {
+    GtkWidget *dialog = gtk_message_dialog_new(
+        GTK_WINDOW(g_main_window),
+        GTK_DIALOG_MODAL,
+        GTK_MESSAGE_QUESTION,
+        GTK_BUTTONS_OK_CANCEL,
+        "Clean up orphaned packages?\n\nThis runs \"yay -Yc --noconfirm\" to remove unused dependencies."
+    );
+    gint response = gtk_dialog_run(GTK_DIALOG(dialog));
+    gtk_widget_destroy(dialog);
+
+    if (response != GTK_RESPONSE_OK || !sudo_password_available()) {
+        return;
+    }
+
+    if (g_status_label) {
+        gtk_label_set_text(GTK_LABEL(g_status_label),
+                           "Cleaning orphaned packages...");
+    }
+
+    start_transaction({ "yay", "-Yc", "--noconfirm" }, "Cleaning orphaned packages...", [](bool ok) {
+        GtkWidget *done = gtk_message_dialog_new(
+            GTK_WINDOW(g_main_window),
+            GTK_DIALOG_MODAL,
+            ok ? GTK_MESSAGE_INFO : GTK_MESSAGE_ERROR,
+            GTK_BUTTONS_OK,
+            ok ?
+              "Orphan cleanup finished." :
+              "Cleanup may have failed.\nCheck the command log or run yay -Yc manually."
+        );
+        if (!ok) show_log_hint(done);
+        gtk_dialog_run(GTK_DIALOG(done));
+        gtk_widget_destroy(done);
+
+        if (g_status_label) {
+            gtk_label_set_text(GTK_LABEL(g_status_label),
+                               "Orphan cleanup complete. You can search again.");
+        }
+    });
+}
+
+// The cleanup preview: one row per orphan, all ticked. Unticking a package
+// keeps the orphans it needs as well; ticking one ticks the orphans that
+// need it. Either way nothing that stays loses a dependency.
+enum { ORPHAN_COL_SELECTED, ORPHAN_COL_NAME, ORPHAN_COL_VERSION, ORPHAN_COL_SIZE, ORPHAN_N_COLS };
+
+struct OrphanPreview {
+    OrphanSet set;
+    std::vector<std::vector<uint32_t>> needed_by;
+    std::vector<bool> selected;
+    GtkWidget *dialog = nullptr;
+    GtkListStore *store = nullptr;
+    GtkWidget *summary = nullptr;
+};
+
+static void update_orphan_preview(OrphanPreview &preview) {
+    size_t count = 0;
+    guint64 bytes = 0;
+    GtkTreeIter iter;
+    GtkTreeModel *model = GTK_TREE_MODEL(preview.store);
+    gboolean valid = gtk_tree_model_get_iter_first(model, &iter);
+    for (size_t i = 0; i < preview.selected.size() && valid; i++) {
+        gtk_list_store_set(preview.store, &iter, ORPHAN_COL_SELECTED, preview.selected[i] ? TRUE : FALSE, -1);
+        if (preview.selected[i]) {
+            count++;
+            bytes += preview.set.packages[i].size;
+        }
+        valid = gtk_tree_model_iter_next(model, &iter);
+    }
+
+    std::string text = "Remove " + std::to_string(count) + " of " +
+                       std::to_string(preview.selected.size()) + " orphaned packages, freeing " +
+                       format_size(static_cast<gint64>(bytes)) + ".";
+    gtk_label_set_text(GTK_LABEL(preview.summary), text.c_str());
+    gtk_dialog_set_response_sensitive(GTK_DIALOG(preview.dialog), GTK_RESPONSE_OK, count > 0);
+}
+
+extern "C" void on_orphan_toggled(GtkCellRendererToggle *, gchar *path_string, gpointer user_data) {
+    auto *preview = static_cast<OrphanPreview *>(user_data);
+    GtkTreePath *path = gtk_tree_path_new_from_string(path_string);
+    size_t row = static_cast<size_t>(gtk_tree_path_get_indices(path)[0]);
+    gtk_tree_path_free(path);
+    if (row >= preview->selected.size()) return;
+
+    bool select = !preview->selected[row];
+    const auto &edges = select ? preview->needed_by : preview->set.needs;
+    std::vector<uint32_t> stack = { static_cast<uint32_t>(row) };
+    while (!stack.empty()) {
+        uint32_t i = stack.back();
+        stack.pop_back();
+        if (preview->selected[i] == select) continue;
+        preview->selected[i] = select;
+        for (uint32_t j : edges[i]) stack.push_back(j);
+    }
+    update_orphan_preview(*preview);
+}
+
+// Ask which orphans to remove. Empty if cancelled.
+static std::vector<std::string> run_orphan_preview(OrphanSet set) {
+    OrphanPreview preview;
+    preview.set = std::move(set);
+    size_t count = preview.set.packages.size();
+    preview.selected.assign(count, true);
+    preview.needed_by.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        for (uint32_t j : preview.set.needs[i]) preview.needed_by[j].push_back(i);
+    }
+
+    preview.dialog = gtk_dialog_new_with_buttons("Clean Orphans", GTK_WINDOW(g_main_window),
+                                                 GTK_DIALOG_MODAL,
+                                                 "_Cancel", GTK_RESPONSE_CANCEL,
+                                                 "_Remove", GTK_RESPONSE_OK,
+                                                 nullptr);
+    gtk_window_set_default_size(GTK_WINDOW(preview.dialog), 520, 420);
+
+    GtkWidget *content = gtk_dialog_get_content_area(GTK_DIALOG(preview.dialog));
+    gtk_box_set_spacing(GTK_BOX(content), 6);
+
+    GtkWidget *intro = gtk_label_new("These packages were installed as dependencies and "
+                                     "nothing installed needs them any more.");
+    gtk_label_set_xalign(GTK_LABEL(intro), 0.0);
+    gtk_label_set_line_wrap(GTK_LABEL(intro), TRUE);
+    gtk_box_pack_start(GTK_BOX(content), intro, FALSE, FALSE, 0);
+
+    preview.store = gtk_list_store_new(ORPHAN_N_COLS, G_TYPE_BOOLEAN, G_TYPE_STRING,
+                                       G_TYPE_STRING, G_TYPE_STRING);
+    for (const auto &pkg : preview.set.packages) {
+        std::string size = format_size(static_cast<gint64>(pkg.size));
+        gtk_list_store_insert_with_values(preview.store, nullptr, -1,
+                                          ORPHAN_COL_SELECTED, TRUE,
+                                          ORPHAN_COL_NAME, pkg.name.c_str(),
+                                          ORPHAN_COL_VERSION, pkg.version.c_str(),
+                                          ORPHAN_COL_SIZE, size.c_str(),
+                                          -1);
+    }
+
+    GtkWidget *view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(preview.store));
+    g_object_unref(preview.store); // the view holds it now
+
+    GtkCellRenderer *toggle = gtk_cell_renderer_toggle_new();
+    g_signal_connect(toggle, "toggled", G_CALLBACK(on_orphan_toggled), &preview);
+    gtk_tree_view_append_column(GTK_TREE_VIEW(view), gtk_tree_view_column_new_with_attributes(
+        "", toggle, "active", ORPHAN_COL_SELECTED, nullptr));
+
+    GtkTreeViewColumn *name_col = gtk_tree_view_column_new_with_attributes(
+        "Package", gtk_cell_renderer_text_new(), "text", ORPHAN_COL_NAME, nullptr);
+    gtk_tree_view_column_set_expand(name_col, TRUE);
+    gtk_tree_view_append_column(GTK_TREE_VIEW(view), name_col);
+    gtk_tree_view_append_column(GTK_TREE_VIEW(view), gtk_tree_view_column_new_with_attributes(
+        "Version", gtk_cell_renderer_text_new(), "text", ORPHAN_COL_VERSION, nullptr));
+    gtk_tree_view_append_column(GTK_TREE_VIEW(view), gtk_tree_view_column_new_with_attributes(
+        "Size", gtk_cell_renderer_text_new(), "text", ORPHAN_COL_SIZE, nullptr));
+
+    GtkWidget *scroll = gtk_scrolled_window_new(nullptr, nullptr);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll),
+                                   GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    gtk_container_add(GTK_CONTAINER(scroll), view);
+    gtk_box_pack_start(GTK_BOX(content), scroll, TRUE, TRUE, 0);
+
+    preview.summary = gtk_label_new("");
+    gtk_label_set_xalign(GTK_LABEL(preview.summary), 0.0);
+    gtk_box_pack_start(GTK_BOX(content), preview.summary, FALSE, FALSE, 0);
+    update_orphan_preview(preview);
+
+    gtk_widget_show_all(preview.dialog);
+    gint response = gtk_dialog_run(GTK_DIALOG(preview.dialog));
+    gtk_widget_destroy(preview.dialog);
+
+    std::vector<std::string> names;
+    if (response != GTK_RESPONSE_OK) return names;
+    for (size_t i = 0; i < count; i++) {
+        if (preview.selected[i]) names.push_back(preview.set.packages[i].name);
+    }
+    return names;
+}
+
+// Work out the orphans in-process and show them; only what the user
+// confirms goes to pacman, in one transaction. No orphans, no subprocess.
+extern "C" void on_clean_orphans_clicked(GtkWidget *button, gpointer user_data) {
+    (void)button;
+    (void)user_data;
+
+    if (!transaction_lane_available()) return;
+
+    if (g_status_label) {
+        gtk_label_set_text(GTK_LABEL(g_status_label), "Looking for orphaned packages...");
+    }
+
+    auto set = std::make_shared<OrphanSet>();
+    auto ok = std::make_shared<bool>(false);
+    auto job = std::make_shared<Job>();
+    job->work = [set, ok](Job &) {
+        std::vector<LocalPackage> pkgs;
+        *ok = read_local_packages(pkgs);
+        if (*ok) *set = find_orphans(std::move(pkgs));
+    };
+    job->finished = [set, ok](Job &) {
+        if (!*ok) {
+            clean_orphans_with_yay();
+            return;
+        }
+
+        if (set->packages.empty()) {
+            if (g_status_label) {
+                gtk_label_set_text(GTK_LABEL(g_status_label), "No orphaned packages found.");
+            }
+            GtkWidget *none = gtk_message_dialog_new(
+                GTK_WINDOW(g_main_window),
+                GTK_DIALOG_MODAL,
+                GTK_MESSAGE_INFO,
+                GTK_BUTTONS_OK,
+                "No orphaned packages.\nEvery dependency is still needed by something installed."
+            );
+            gtk_dialog_run(GTK_DIALOG(none));
+            gtk_widget_destroy(none);
+            return;
+        }
+
+        std::vector<std::string> names = run_orphan_preview(std::move(*set));
+        if (names.empty() || !sudo_password_available()) {
+            if (g_status_label) gtk_label_set_text(GTK_LABEL(g_status_label), "Orphan cleanup cancelled.");
+            return;
+        }
+
+        std::string info_text = "Removing " + std::to_string(names.size()) + " orphaned packages...";
+        if (g_status_label) gtk_label_set_text(GTK_LABEL(g_status_label), info_text.c_str());
+
+        // The list is already closed under dependencies, so no -s: that
+        // would also take orphans the user chose to keep.
+        std::vector<std::string> argv = { "sudo", "-S", "pacman", "-Rn", "--noconfirm" };
+        argv.insert(argv.end(), names.begin(), names.end());
+        start_transaction(argv, info_text, [](bool ok) {
+            GtkWidget *done = gtk_message_dialog_new(
+                GTK_WINDOW(g_main_window),
+                GTK_DIALOG_MODAL,
+                ok ? GTK_MESSAGE_INFO : GTK_MESSAGE_ERROR,
+                GTK_BUTTONS_OK,
+                ok ?
+                  "Orphan cleanup finished." :
+                  "Cleanup may have failed.\nCheck the command log or run pacman -Rn manually."
+            );
+            if (!ok) show_log_hint(done);
+            gtk_dialog_run(GTK_DIALOG(done));
+            gtk_widget_destroy(done);
+
+            refresh_after_transaction();
+            if (g_status_label && g_results.empty()) {
+                gtk_label_set_text(GTK_LABEL(g_status_label),
+                                   "Orphan cleanup complete. You can search again.");
+            }
+        }, true);
+    };
+    g_index_jobs->submit(job);
+}
+
+// ───────────────────────────────────────────────
+//  Transaction queue
+// ───────────────────────────────────────────────
+
+// Packages picked across any number of searches, applied together: one
+// `yay -S` for all installs and one `yay -Rns` for all removals, so pacman
+// resolves dependencies, downloads and runs hooks once per batch.
+
+static void queue_add(std::vector<std::string> &queue, std::string_view name) {
+    if (std::find(queue.begin(), queue.end(), name) == queue.end()) {
+        queue.emplace_back(name);
+    }
+}
+
+static void queue_remove(std::vector<std::string> &queue, std::string_view name) {
+    queue.erase(std::remove(queue.begin(), queue.end(), name), queue.end());
+}
+
+bool is_queued(std::string_view name) {
+    return std::find(g_queued_installs.begin(), g_queued_installs.end(), name) != g_queued_installs.end() ||
+           std::find(g_queued_removals.begin(), g_queued_removals.end(), name) != g_queued_removals.end();
+}
+
+void update_queue_button() {
+    if (!g_apply_queue_button) return;
+
+    size_t n = g_queued_installs.size() + g_queued_removals.size();
+    std::string label = "Apply Queue (" + std::to_string(n) + ")";
+    gtk_button_set_label(GTK_BUTTON(g_apply_queue_button), label.c_str());
+    gtk_widget_set_sensitive(g_apply_queue_button, n > 0);
+}
+
+// Queue every selected row: uninstalled ones for install, installed ones
+// for removal. Selecting an already-queued row takes it off the queue.
+extern "C" void on_queue_selected_clicked(GtkWidget *, gpointer) {
+    GtkTreeSelection *selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(g_results_list));
+    GtkTreeModel *model = nullptr;
+    GList *rows = gtk_tree_selection_get_selected_rows(selection, &model);
+
+    for (GList *it = rows; it; it = it->next) {
+        GtkTreeIter iter;
+        if (!gtk_tree_model_get_iter(model, &iter, static_cast<GtkTreePath *>(it->data))) continue;
+        const PackageInfo *pkg = package_at(model, &iter);
+        if (!pkg) continue;
+
+        if (is_queued(pkg->name)) {
+            queue_remove(g_queued_installs, pkg->name);
+            queue_remove(g_queued_removals, pkg->name);
+        } else if (pkg->installed()) {
+            queue_add(g_queued_removals, pkg->name);
+        } else {
+            queue_add(g_queued_installs, pkg->name);
+        }
+    }
+    g_list_free_full(rows, reinterpret_cast<GDestroyNotify>(gtk_tree_path_free));
+
+    gtk_tree_selection_unselect_all(selection);
+    gtk_widget_queue_draw(g_results_list);
+    update_queue_button();
+}
+
+static std::string join_names(const std::vector<std::string> &names, const char *sep) {
+    std::string out;
+    for (const auto &name : names) {
+        if (!out.empty()) out += sep;
+        out += name;
+    }
+    return out;
+}
+
+// After a batch: anything that did not reach the state it was queued for
+// goes back on the queue so it can be retried.
+static void requeue_failures(const std::vector<std::string> &names, bool wanted_installed) {
+    for (const auto &name : names) {
+        if (is_package_installed(name) != wanted_installed) {
+            queue_add(wanted_installed ? g_queued_installs : g_queued_removals, name);
+        }
+    }
+    update_queue_button();
+    if (g_results_list) gtk_widget_queue_draw(g_results_list);
+}
+
+static void report_batch_result(bool ok, const char *failure) {
+    refresh_after_transaction();
+    if (ok) return;
+
+    GtkWidget *done = gtk_message_dialog_new(
+        GTK_WINDOW(g_main_window),
+        GTK_DIALOG_MODAL,
+        GTK_MESSAGE_ERROR,
+        GTK_BUTTONS_OK,
+        "%s\nCheck the command log or run yay manually.",
+        failure
+    );
+    show_log_hint(done);
+    gtk_dialog_run(GTK_DIALOG(done));
+    gtk_widget_destroy(done);
+}
+
+enum { QUEUE_RESPONSE_CLEAR = 1 };
+
+extern "C" void on_apply_queue_clicked(GtkWidget *, gpointer) {
+    if (g_queued_installs.empty() && g_queued_removals.empty()) return;
+    if (!transaction_lane_available()) return;
+
+    std::string summary;
+    if (!g_queued_installs.empty()) {
+        summary += "Install (" + std::to_string(g_queued_installs.size()) + "):\n  " +
+                   join_names(g_queued_installs, "\n  ") + "\n\n";
+    }
+    if (!g_queued_removals.empty()) {
+        summary += "Remove with unused dependencies (" + std::to_string(g_queued_removals.size()) +
+                   "):\n  " + join_names(g_queued_removals, "\n  ") + "\n";
+    }
+
+    GtkWidget *dialog = gtk_message_dialog_new(
+        GTK_WINDOW(g_main_window),
+        GTK_DIALOG_MODAL,
+        GTK_MESSAGE_QUESTION,
+        GTK_BUTTONS_NONE,
+        "Apply queued changes?\n\n%s",
+        summary.c_str()
+    );
+    gtk_dialog_add_buttons(GTK_DIALOG(dialog),
+                           "Clear Queue", QUEUE_RESPONSE_CLEAR,
+                           "_Cancel", GTK_RESPONSE_CANCEL,
+                           "_Apply", GTK_RESPONSE_OK,
+                           nullptr);
+    gint response = gtk_dialog_run(GTK_DIALOG(dialog));
+    gtk_widget_destroy(dialog);
+
+    if (response == QUEUE_RESPONSE_CLEAR) {
+        g_queued_installs.clear();
+        g_queued_removals.clear();
+        update_queue_button();
+        gtk_widget_queue_draw(g_results_list);
+        return;
+    }
+    if (response != GTK_RESPONSE_OK || !sudo_password_available()) {
+        return;
+    }
+
+    if (g_status_label) {
+        gtk_label_set_text(GTK_LABEL(g_status_label), "Applying queued changes...");
+    }
+
+    std::vector<std::string> installs;
+    std::vector<std::string> removals;
+    installs.swap(g_queued_installs);
+    removals.swap(g_queued_removals);
+    update_queue_button();
+
+    // Everything goes on the transaction lane, so the batches run back to
+    // back; repo downloads overlap with whatever runs ahead of them.
+    if (!installs.empty()) {
+        start_install(installs, [](const std::vector<std::string> &names, bool ok) {
+            requeue_failures(names, true);
+            report_batch_result(ok, "Installation may have failed.");
+        });
+    }
+
+    if (!removals.empty()) {
+        std::vector<std::string> argv = { "yay", "-Rns", "--noconfirm" };
+        argv.insert(argv.end(), removals.begin(), removals.end());
+
+        std::string info_text = "Removing " + std::to_string(removals.size()) + " packages...";
+        start_transaction(argv, info_text, [removals](bool ok) {
+            requeue_failures(removals, false);
+            report_batch_result(ok, "Removal may have failed.");
+        });
+    }
+}
+
+// ───────────────────────────────────────────────
+//  UI helpers
+// ───────────────────────────────────────────────
+
+// The results list is a GtkTreeView: GTK only measures and draws the rows
+// that are on screen, and each model row is just an index into g_results.
+enum { RESULT_COL_INDEX, RESULT_N_COLS };
+
+static const PackageInfo *package_at(GtkTreeModel *model, GtkTreeIter *iter) {
+    guint index = 0;
+    gtk_tree_model_get(model, iter, RESULT_COL_INDEX, &index, -1);
+    return index < g_results.size() ? &g_results.items[index] : nullptr;
+}
+
+// Idle source still adding ranked rows (see show_more_matches), and the
+// row count it is working towards.
+static guint g_fill_rows_id = 0;
+static size_t g_fill_rows_target = 0;
+
+void clear_results() {
+    if (g_fill_rows_id) {
+        g_source_remove(g_fill_rows_id);
+        g_fill_rows_id = 0;
+    }
+    gtk_list_store_clear(g_results_store);
+    g_results.clear();
+    g_matches.clear();
+    g_match_order.clear();
+    g_match_scores.clear();
+
+    g_results_total = 0;
+    g_results_installed = 0;
+}
+
+// Package icons by name. The icon cell only asks for rows GTK is drawing;
+// the first time a name comes up its icon is loaded in the background and
+// the generic one is shown until it arrives. Names without an icon are
+// remembered too, so the theme is only consulted once per package.
+struct IconEntry {
+    enum State { Loading, Loaded, Missing } state = Loading;
+    GdkPixbuf *pixbuf = nullptr;
+};
+
+static std::unordered_map<std::string, IconEntry> g_icon_cache;
+static guint g_icon_generation = 0;   // bumped when the theme changes
+static guint g_icon_redraw_id  = 0;
+
+static const char *const FALLBACK_ICON = "system-software-install";
+
+static void clear_icon_cache() {
+    for (auto &entry : g_icon_cache) {
+        if (entry.second.pixbuf) g_object_unref(entry.second.pixbuf);
+    }
+    g_icon_cache.clear();
+    g_icon_generation++;
+}
+
+extern "C" void on_icon_theme_changed(GtkIconTheme *, gpointer) {
+    clear_icon_cache();
+    if (g_results_list) gtk_widget_queue_draw(g_results_list);
+}
+
+// Several icons tend to finish together; redraw the list once for them.
+static gboolean redraw_icons(gpointer) {
+    g_icon_redraw_id = 0;
+    if (g_results_list) gtk_widget_queue_draw(g_results_list);
+    return G_SOURCE_REMOVE;
+}
+
+struct IconLoad {
+    std::string name;
+    guint generation;
+};
+
+extern "C" void on_icon_loaded(GObject *source, GAsyncResult *result, gpointer user_data) {
+    std::unique_ptr<IconLoad> load(static_cast<IconLoad *>(user_data));
+    GError *error = nullptr;
+    GdkPixbuf *pixbuf = gtk_icon_info_load_icon_finish(GTK_ICON_INFO(source), result, &error);
+    g_object_unref(source);
+    if (error) g_error_free(error);
+
+    auto it = g_icon_cache.find(load->name);
+    if (load->generation != g_icon_generation || it == g_icon_cache.end()) {
+        if (pixbuf) g_object_unref(pixbuf);
+        return;
+    }
+    it->second.state = pixbuf ? IconEntry::Loaded : IconEntry::Missing;
+    it->second.pixbuf = pixbuf;
+    if (pixbuf && !g_icon_redraw_id) g_icon_redraw_id = g_idle_add(redraw_icons, nullptr);
+}
+
+// The icon for `name` if it is loaded; otherwise null, starting a load
+// the first time.
+static GdkPixbuf *lookup_package_icon(std::string_view name) {
+    std::string key(name);
+    auto it = g_icon_cache.find(key);
+    if (it != g_icon_cache.end()) return it->second.pixbuf;
+
+    IconEntry &entry = g_icon_cache[key];
+    gint size = 48;
+    gtk_icon_size_lookup(GTK_ICON_SIZE_DIALOG, &size, nullptr);
+    GtkIconInfo *info = gtk_icon_theme_lookup_icon(gtk_icon_theme_get_default(), key.c_str(), size,
+                                                   GTK_ICON_LOOKUP_FORCE_SIZE);
+    if (!info) {
+        entry.state = IconEntry::Missing;
+        return nullptr;
+    }
+    gtk_icon_info_load_icon_async(info, nullptr, on_icon_loaded,
+                                  new IconLoad{ std::move(key), g_icon_generation });
+    return nullptr;
+}
+
+static void render_icon_cell(GtkTreeViewColumn *, GtkCellRenderer *cell,
+                             GtkTreeModel *model, GtkTreeIter *iter, gpointer) {
+    const PackageInfo *pkg = package_at(model, iter);
+    if (!pkg) return;
+
+    if (GdkPixbuf *pixbuf = lookup_package_icon(pkg->name)) {
+        g_object_set(cell, "pixbuf", pixbuf, nullptr);
+    } else {
+        g_object_set(cell, "icon-name", FALLBACK_ICON, nullptr); // Generic software icon fallback
+    }
+}
+
+static void render_text_cell(GtkTreeViewColumn *, GtkCellRenderer *cell,
+                             GtkTreeModel *model, GtkTreeIter *iter, gpointer) {
+    const PackageInfo *pkg = package_at(model, iter);
+    if (!pkg) return;
+
+    // First line: "<name> -- <version>" plus repo tag, description below
+    std::string name(pkg->name);
+    std::string version(pkg->version);
+    std::string repo(pkg->repo_name());
+    std::string description(pkg->description);
+    gchar *markup = g_markup_printf_escaped(
+        "<b>%s</b> -- %s  [%s]\n%s",
+        name.c_str(), version.c_str(), repo.c_str(), description.c_str());
+    g_object_set(cell, "markup", markup, nullptr);
+    g_free(markup);
+}
+
+static void render_action_cell(GtkTreeViewColumn *, GtkCellRenderer *cell,
+                               GtkTreeModel *model, GtkTreeIter *iter, gpointer) {
+    const PackageInfo *pkg = package_at(model, iter);
+    if (!pkg) return;
+
+    // No partial upgrades on Arch: a row's upgrade is the whole system's.
+    const char *label = pkg->upgrade() ? "Upgrade System"
+                      : is_queued(pkg->name) ? "Queued"
+                      : pkg->installed() ? "Remove" : "Install";
+    g_object_set(cell, "text", label, nullptr);
+}
+
+static GtkTreeViewColumn *g_action_column = nullptr;
+
+// Install or remove the package in this row. Deferred to an idle so the
+// confirmation dialog does not run inside the tree view's event handler.
+static void activate_result_row(GtkTreePath *path) {
+    GtkTreeIter iter;
+    GtkTreeModel *model = GTK_TREE_MODEL(g_results_store);
+    if (!gtk_tree_model_get_iter(model, &iter, path)) return;
+
+    const PackageInfo *pkg = package_at(model, &iter);
+    if (!pkg) return;
+
+    std::string name(pkg->name);
+    bool installed = pkg->installed();
+    bool upgrade = pkg->upgrade();
+    run_on_main_thread([name, installed, upgrade] {
+        if (upgrade) {
+            on_upgrade_all_clicked(nullptr, nullptr);
+        } else if (installed) {
+            on_remove_clicked(nullptr, const_cast<char *>(name.c_str()));
+        } else {
+            on_install_clicked(nullptr, const_cast<char *>(name.c_str()));
+        }
+    });
+}
+
+// Enter or double-click on a row.
+extern "C" void on_result_row_activated(GtkTreeView *, GtkTreePath *path,
+                                        GtkTreeViewColumn *, gpointer) {
+    activate_result_row(path);
+}
+
+// A single click on the "Install"/"Remove" cell acts like the old button.
+extern "C" gboolean on_results_button_press(GtkWidget *widget, GdkEventButton *event,
+                                            gpointer) {
+    if (event->type != GDK_BUTTON_PRESS || event->button != 1) return FALSE;
+
+    GtkTreePath *path = nullptr;
+    GtkTreeViewColumn *column = nullptr;
+    if (!gtk_tree_view_get_path_at_pos(GTK_TREE_VIEW(widget),
+                                       static_cast<gint>(event->x),
+                                       static_cast<gint>(event->y),
+                                       &path, &column, nullptr, nullptr)) {
+        return FALSE;
+    }
+
+    if (column == g_action_column) {
+        activate_result_row(path);
+    }
+    gtk_tree_path_free(path);
+    return FALSE;
+}
+
+GtkWidget *create_results_view() {
+    g_results_store = gtk_list_store_new(RESULT_N_COLS, G_TYPE_UINT);
+
+    GtkWidget *view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(g_results_store));
+    g_object_unref(g_results_store); // the view holds the reference
+    gtk_tree_view_set_headers_visible(GTK_TREE_VIEW(view), FALSE);
+    gtk_tree_view_set_grid_lines(GTK_TREE_VIEW(view), GTK_TREE_VIEW_GRID_LINES_HORIZONTAL);
+    gtk_tree_view_set_enable_search(GTK_TREE_VIEW(view), FALSE);
+    gtk_tree_selection_set_mode(gtk_tree_view_get_selection(GTK_TREE_VIEW(view)),
+                                GTK_SELECTION_MULTIPLE);
+
+    // Icon
+    GtkCellRenderer *icon = gtk_cell_renderer_pixbuf_new();
+    g_object_set(icon, "stock-size", GTK_ICON_SIZE_DIALOG, "xpad", 8, "ypad", 4, nullptr);
+    GtkTreeViewColumn *icon_col = gtk_tree_view_column_new();
+    gtk_tree_view_column_pack_start(icon_col, icon, FALSE);
+    gtk_tree_view_column_set_cell_data_func(icon_col, icon, render_icon_cell, nullptr, nullptr);
+    gtk_tree_view_column_set_sizing(icon_col, GTK_TREE_VIEW_COLUMN_FIXED);
+    gtk_tree_view_column_set_fixed_width(icon_col, 64);
+    gtk_tree_view_append_column(GTK_TREE_VIEW(view), icon_col);
+
+    // Name / version / repo / description
+    GtkCellRenderer *text = gtk_cell_renderer_text_new();
+    g_object_set(text, "ellipsize", PANGO_ELLIPSIZE_END, "ypad", 4, nullptr);
+    GtkTreeViewColumn *text_col = gtk_tree_view_column_new();
+    gtk_tree_view_column_pack_start(text_col, text, TRUE);
+    gtk_tree_view_column_set_cell_data_func(text_col, text, render_text_cell, nullptr, nullptr);
+    gtk_tree_view_column_set_sizing(text_col, GTK_TREE_VIEW_COLUMN_FIXED);
+    gtk_tree_view_column_set_expand(text_col, TRUE);
+    gtk_tree_view_append_column(GTK_TREE_VIEW(view), text_col);
+
+    // Right side: Install or Remove
+    GtkCellRenderer *action = gtk_cell_renderer_text_new();
+    g_object_set(action, "xpad", 12, "weight", PANGO_WEIGHT_BOLD, "underline", PANGO_UNDERLINE_SINGLE, nullptr);
+    g_action_column = gtk_tree_view_column_new();
+    gtk_tree_view_column_pack_start(g_action_column, action, FALSE);
+    gtk_tree_view_column_set_cell_data_func(g_action_column, action, render_action_cell, nullptr, nullptr);
+    gtk_tree_view_column_set_sizing(g_action_column, GTK_TREE_VIEW_COLUMN_FIXED);
+    gtk_tree_view_column_set_fixed_width(g_action_column, 96);
+    gtk_tree_view_append_column(GTK_TREE_VIEW(view), g_action_column);
+
+    // Every row is two lines tall, so GTK can skip measuring off-screen rows.
+    gtk_tree_view_set_fixed_height_mode(GTK_TREE_VIEW(view), TRUE);
+
+    g_signal_connect(view, "row-activated", G_CALLBACK(on_result_row_activated), nullptr);
+    g_signal_connect(view, "button-press-event", G_CALLBACK(on_results_button_press), nullptr);
+    g_signal_connect(view, "cursor-changed", G_CALLBACK(on_results_cursor_changed), nullptr);
+    g_signal_connect(gtk_icon_theme_get_default(), "changed",
+                     G_CALLBACK(on_icon_theme_changed), nullptr);
+
+    return view;
+}
+
+void update_results_status(bool still_searching) {
+    if (!g_status_label) return;
+
+    std::string status = "Results: " + std::to_string(g_results_total) +
+                         "  | Installed: " + std::to_string(g_results_installed) +
+                         " (already on system)";
+    if (g_results.size() < static_cast<size_t>(g_results_total))
+        status += "  | Showing best " + std::to_string(g_results.size()) + ", scroll for more";
+    if (still_searching) status += "  | Searching...";
+    gtk_label_set_text(GTK_LABEL(g_status_label), status.c_str());
+}
+
+// Re-check every match against the installed index. Only rows on screen
+// whose flag actually flipped are redrawn.
+void refresh_installed_flags() {
+    TraceScope trace("installed checks");
+    g_results_installed = 0;
+    for (auto &pkg : g_matches.items) {
+        pkg.set_installed(is_package_installed(pkg.name));
+        if (pkg.installed()) g_results_installed++;
+    }
+
+    GtkTreeModel *model = GTK_TREE_MODEL(g_results_store);
+    GtkTreeIter iter;
+    for (gboolean valid = gtk_tree_model_get_iter_first(model, &iter); valid;
+         valid = gtk_tree_model_iter_next(model, &iter)) {
+        guint index = 0;
+        gtk_tree_model_get(model, &iter, RESULT_COL_INDEX, &index, -1);
+        if (index >= g_results.size()) continue;
+
+        PackageInfo &pkg = g_results.items[index];
+        bool installed = is_package_installed(pkg.name);
+        if (installed == pkg.installed()) continue;
+
+        pkg.set_installed(installed);
+        GtkTreePath *path = gtk_tree_model_get_path(model, &iter);
+        gtk_tree_model_row_changed(model, path, &iter);
+        gtk_tree_path_free(path);
+    }
+
+    update_results_status(!g_shown_query_complete);
+}
+
+static void append_row(const PackageInfo &pkg) {
+    guint index = static_cast<guint>(g_results.size());
+    g_results.items.push_back(pkg);
+    gtk_list_store_insert_with_values(g_results_store, nullptr, -1,
+                                      RESULT_COL_INDEX, index, -1);
+}
+
+// ───────────────────────────────────────────────
+//  Result ranking
+// ───────────────────────────────────────────────
+
+// Rows materialized per page; more are added when the list is scrolled
+// to the bottom.
+static const size_t RESULT_PAGE_SIZE = 200;
+
+// True if the letters of `term` appear in `text` in order ("gthm" in
+// "gtk-theme-manager").
+static bool is_subsequence(const std::string &term, const std::string &text) {
+    size_t at = 0;
+    for (char c : term) {
+        at = text.find(c, at);
+        if (at == std::string::npos) return false;
+        at++;
+    }
+    return true;
+}
+
+// Higher is better. Name matches dominate: exact, then prefix, then a
+// substring (more at the start of a "-" separated word), then the letters
+// in order; a term found only in the description adds nothing. Among
+// similar matches, shorter names, installed packages and AUR packages
+// with more votes come first.
+static int32_t score_match(const PackageInfo &pkg, const std::vector<std::string> &terms,
+                           std::string &name) {
+    name.clear();
+    for (char c : pkg.name) name.push_back(fold_ascii(c));
+
+    // Nothing to rank against (the update list): keep the given order.
+    if (terms.empty()) return 0;
+
+    int32_t score = 0;
+    for (const auto &term : terms) {
+        if (term.empty()) continue;
+        if (name == term) {
+            score += 1000;
+        } else if (name.compare(0, term.size(), term) == 0) {
+            score += 500;
+        } else {
+            size_t pos = name.find(term);
+            if (pos != std::string::npos) {
+                char before = name[pos - 1];
+                score += (before == '-' || before == '_' || before == '.') ? 300 : 200;
+            } else if (is_subsequence(term, name)) {
+                score += 80;
+            }
+        }
+    }
+
+    score -= static_cast<int32_t>(std::min<size_t>(name.size(), 60));
+    if (pkg.installed()) score += 25;
+    for (uint32_t v = pkg.votes; v; v >>= 1) score += 12; // ~log2(votes)
+    return score;
+}
+
+// Rank g_match_order[begin, end) into place: best score first, ties in
+// the order the backend returned them.
+static void rank_matches(size_t begin, size_t end) {
+    auto better = [](uint32_t a, uint32_t b) {
+        if (g_match_scores[a] != g_match_scores[b]) return g_match_scores[a] > g_match_scores[b];
+        return a < b;
+    };
+    std::partial_sort(g_match_order.begin() + begin, g_match_order.begin() + end,
+                      g_match_order.end(), better);
+}
+
+// Time one main-loop turn may spend adding rows, so a frame can be drawn
+// between batches.
+static const gint64 RESULT_FILL_BUDGET_US = 4000;
+
+// Add ranked rows until g_fill_rows_target or the time budget runs out.
+// True when the target was reached.
+static bool fill_rows() {
+    TraceScope trace("add rows");
+    gint64 deadline = g_get_monotonic_time() + RESULT_FILL_BUDGET_US;
+    while (g_results.size() < g_fill_rows_target) {
+        append_row(g_matches.items[g_match_order[g_results.size()]]);
+        if (g_results.size() % 32 == 0 && g_get_monotonic_time() >= deadline) return false;
+    }
+    return true;
+}
+
+static gboolean fill_rows_on_idle(gpointer) {
+    if (!fill_rows()) return G_SOURCE_CONTINUE;
+    g_fill_rows_id = 0;
+    update_results_status(!g_shown_query_complete);
+    return G_SOURCE_REMOVE;
+}
+
+// Add the next page of ranked matches below the rows on screen. The first
+// batch goes in right away; the rest follows from an idle source, which
+// clear_results cancels when a new search replaces the list.
+static void show_more_matches() {
+    if (g_fill_rows_id) return;
+    size_t shown = g_results.size();
+    size_t end = std::min(g_match_order.size(), shown + RESULT_PAGE_SIZE);
+    if (shown >= end) return;
+
+    rank_matches(shown, end);
+    g_fill_rows_target = end;
+    if (!fill_rows()) g_fill_rows_id = g_idle_add(fill_rows_on_idle, nullptr);
+}
+
+// Replace the list with `pkgs`, scored against g_shown_query. Only the
+// first page is sorted and turned into rows.
+void show_matches(PackageList pkgs) {
+    TraceScope trace("rank results");
+    clear_results();
+    g_matches = std::move(pkgs);
+    g_results.keep_storage_of(g_matches);
+
+    std::vector<std::string> terms = fold_terms(split_search_terms(g_shown_query));
+    std::string name;
+    size_t n = g_matches.size();
+    g_match_order.resize(n);
+    g_match_scores.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        const PackageInfo &pkg = g_matches.items[i];
+        g_match_order[i] = static_cast<uint32_t>(i);
+        g_match_scores[i] = score_match(pkg, terms, name);
+        if (pkg.installed()) g_results_installed++;
+    }
+    g_results_total = static_cast<int>(n);
+
+    show_more_matches();
+    update_results_status(false);
+}
+
+// Streaming search: collect the new matches and show them as they come,
+// unranked, until the first page is full. The final chunk re-ranks the lot.
+void append_results(const PackageList &pkgs) {
+    g_matches.keep_storage_of(pkgs);
+    g_results.keep_storage_of(pkgs);
+    for (const auto &pkg : pkgs.items) {
+        g_results_total++;
+        if (pkg.installed()) g_results_installed++;
+        g_matches.items.push_back(pkg);
+        if (g_results.size() < RESULT_PAGE_SIZE) append_row(pkg);
+    }
+}
+
+extern "C" void on_results_edge_reached(GtkScrolledWindow *, GtkPositionType pos, gpointer) {
+    if (pos != GTK_POS_BOTTOM || !g_shown_query_complete) return;
+    size_t shown = g_results.size();
+    show_more_matches();
+    if (g_results.size() != shown) update_results_status(false);
+}
+
+// ───────────────────────────────────────────────
+//  Search logic
+// ───────────────────────────────────────────────
+
+// The `yay -Ss` child for the search currently on screen, if still running,
+// and a counter bumped by every new search so stale callbacks can bail out.
+static ProcessPtr g_search_process;
+static guint g_search_generation = 0;
+static gint64 g_search_trace_start = 0;  // when perform_search started it
+
+// The AUR RPC request of the current search while it is queued or
+// running; a new search cancels it so the AUR lane does not work through
+// every keystroke's query before details, builds or update checks.
+static JobPtr g_aur_search_job;
+// Some source of the current search failed: its results are not cached.
+static bool g_search_source_failed = false;
+
+// Pending "search as you type" timeout.
+static guint g_search_debounce_id = 0;
+
+// Delay after the last keystroke before searching. The offline index is
+// cheap to query; a request to the AUR is not, so wait longer for it.
+static const guint SEARCH_DEBOUNCE_INDEX_MS   = 120;
+static const guint SEARCH_DEBOUNCE_NETWORK_MS = 450;
+
+// Queries differing only in case or spacing share a cache entry.
+static std::string search_cache_key(const std::string &query) {
+    std::string key;
+    for (const auto &term : fold_terms(split_search_terms(query))) {
+        if (!key.empty()) key.push_back(' ');
+        key += term;
+    }
+    return key;
+}
+
+// The matches are the final answer for g_shown_query; remember them for
+// the next time it comes up.
+static void finish_search() {
+    trace_record("search", g_search_trace_start, g_shown_query);
+    g_search_trace_start = 0;
+    g_shown_query_complete = true;
+    if (!g_search_source_failed) g_search_cache.insert(search_cache_key(g_shown_query), g_matches);
+}
+
+// A search can have several sources reporting separately (the repos and
+// the AUR). Rows are listed as they come; once the last source is done the
+// whole set is ranked and cached.
+static int g_search_sources_pending = 0;
+static bool g_search_rows_shown = false;   // old rows cleared yet?
+
+// Rows from one source of the current search; `last` when it has no more.
+static void add_search_rows(PackageList &rows, bool last) {
+    // Keep the previous results up until there is something to replace them.
+    if (!g_search_rows_shown && (!rows.empty() || last)) {
+        clear_results();
+        g_search_rows_shown = true;
+    }
+
+    // Double-check installed status against the local DB so the Remove button is accurate
+    {
+        TraceScope trace("installed checks");
+        for (auto &pkg : rows.items) {
+            pkg.set_installed(is_package_installed(pkg.name));
+        }
+    }
+    append_results(rows);
+
+    if (!last || --g_search_sources_pending > 0) {
+        if (g_search_rows_shown) update_results_status(true);
+        return;
+    }
+
+    // Everything is in; put the best matches on top.
+    PackageList all = std::move(g_matches);
+    show_matches(std::move(all));
+    finish_search();
+
+    if (g_results_total == 0 && g_status_label) {
+        gtk_label_set_text(GTK_LABEL(g_status_label), "No results found.");
+    }
+}
+
+// Parser state for one running search. Chunks are parsed in order on the
+// search job lane, and the packages each chunk completed go to the list.
+struct SearchStream {
+    YaySearchParser parser;
+    PackageList batch;              // worker thread only
+
+    SearchStream() : parser([this](const PackageInfo &pkg) { batch.items.push_back(pkg); }) {
+        batch.keep_arena(parser.arena());
+    }
+};
+
+static void queue_search_chunk(const std::shared_ptr<SearchStream> &stream,
+                               guint generation, std::string chunk, bool last) {
+    auto rows = std::make_shared<PackageList>();
+
+    auto job = std::make_shared<Job>();
+    job->work = [stream, rows, chunk = std::move(chunk), last](Job &) {
+        TraceScope trace("parse_yay_search");
+        stream->parser.feed(chunk.data(), chunk.size());
+        if (last) stream->parser.finish();
+        rows->items.swap(stream->batch.items);
+        rows->keep_arena(stream->parser.arena());
+    };
+    job->finished = [rows, generation, last](Job &self) {
+        if (self.cancelled || generation != g_search_generation) return;
+        add_search_rows(*rows, last);
+    };
+    g_search_jobs->submit(job);
+}
+
+// Split the entry text into separate search terms, like the shell used to.
+static std::vector<std::string> split_search_terms(const std::string &query) {
+    std::vector<std::string> terms;
+    std::istringstream iss(query);
+    std::string term;
+    while (iss >> term) terms.push_back(term);
+    return terms;
+}
+
+// pacman treats search terms as regular expressions. The offline index
+// only does plain substring matching, so leave anything regex-looking to
+// yay. ('.' and '+' are common in package names and matched literally.)
+static bool terms_need_regex(const std::vector<std::string> &terms) {
+    for (const auto &term : terms) {
+        if (term.find_first_of("^$*?()[]{}|\\") != std::string::npos) return true;
+    }
+    return false;
+}
+
+static std::vector<std::string> fold_terms(const std::vector<std::string> &terms) {
+    std::vector<std::string> folded;
+    for (const auto &term : terms) {
+        std::string f;
+        for (char c : term) f.push_back(fold_ascii(c));
+        folded.push_back(f);
+    }
+    return folded;
+}
+
+// True if every row matching `next` must also match `prev`: each old term
+// is contained in some new term ("pyth" -> "python", "gtk" -> "gtk themes").
+static bool query_refines(const std::vector<std::string> &prev,
+                          const std::vector<std::string> &next) {
+    if (prev.empty()) return false;
+    for (const auto &old_term : prev) {
+        bool implied = false;
+        for (const auto &new_term : next) {
+            if (new_term.find(old_term) != std::string::npos) {
+                implied = true;
+                break;
+            }
+        }
+        if (!implied) return false;
+    }
+    return true;
+}
+
+// Narrow the previous matches instead of searching from scratch.
+static void refine_results(const std::vector<std::string> &terms) {
+    TraceScope trace("refine results");
+    std::vector<std::string> folded = fold_terms(terms);
+    PackageList kept;
+    kept.keep_storage_of(g_matches);
+    std::string text;
+
+    for (const auto &pkg : g_matches.items) {
+        text.clear();
+        for (char c : pkg.name) text.push_back(fold_ascii(c));
+        text.push_back('\n');
+        for (char c : pkg.description) text.push_back(fold_ascii(c));
+
+        bool all = true;
+        for (const auto &term : folded) {
+            if (text.find(term) == std::string::npos) {
+                all = false;
+                break;
+            }
+        }
+        if (all) {
+            kept.items.push_back(pkg);
+            kept.items.back().set_installed(is_package_installed(pkg.name));
+        }
+    }
+
+    bool none = kept.empty();
+    show_matches(std::move(kept));
+    finish_search();
+
+    if (none && g_status_label) {
+        gtk_label_set_text(GTK_LABEL(g_status_label), "No results found.");
+    }
+}
+
+static void search_catalog(const CatalogPtr &catalog, const std::vector<std::string> &terms,
+                           guint generation) {
+    auto pkgs = std::make_shared<PackageList>();
+
+    auto job = std::make_shared<Job>();
+    job->work = [catalog, terms, pkgs](Job &) {
+        TraceScope trace("catalog search");
+        for (uint32_t id : catalog->search(fold_terms(terms))) {
+            pkgs->items.push_back(catalog->package(id));
+        }
+        pkgs->keep(catalog);
+    };
+    job->finished = [pkgs, generation](Job &self) {
+        if (self.cancelled || generation != g_search_generation) return;
+        add_search_rows(*pkgs, true);
+    };
+    g_search_jobs->submit(job);
+}
+
+// The AUR part of a search, straight from the RPC.
+static void search_aur(const std::vector<std::string> &terms, guint generation) {
+    g_aur_search_job = aur_rpc_search(terms, [generation](bool ok, PackageList &pkgs,
+                                                          const std::string &error) {
+        if (generation != g_search_generation) return;
+        g_aur_search_job.reset();
+        if (!ok) {
+            g_printerr("AUR search failed; showing repo results only.\n");
+            g_search_source_failed = true;
+        }
+        add_search_rows(pkgs, true);
+        if (!ok && g_status_label) {
+            std::string msg = "AUR search failed" + (error.empty() ? std::string() : " (" + error + ")") +
+                              "; showing repo results only.";
+            gtk_label_set_text(GTK_LABEL(g_status_label), msg.c_str());
+        }
+    });
+}
+
+// Stream `argv`'s `-Ss` style output into the results.
+static void search_with_process(const std::vector<std::string> &argv, guint generation) {
+    auto stream = std::make_shared<SearchStream>();
+
+    ProcessCallbacks callbacks;
+    callbacks.on_stdout = [stream, generation](const char *data, size_t len) {
+        if (generation != g_search_generation) return;
+        queue_search_chunk(stream, generation, std::string(data, len), false);
+    };
+    callbacks.on_stderr = forward_to_stderr("search");
+    callbacks.on_exit = [stream, generation](bool) {
+        // Superseded by a newer search (or killed for one).
+        if (generation != g_search_generation) return;
+        g_search_process.reset();
+
+        // pacman and yay exit non-zero when nothing matches; flush whatever we got.
+        queue_search_chunk(stream, generation, std::string(), true);
+    };
+
+    g_search_process = spawn_process(argv, std::move(callbacks));
+}
+
+// Run a search for `query`. With `allow_refine`, a query that only narrows
+// the (complete) results on screen filters them in place instead.
+static void perform_search(const std::string &query, bool allow_refine) {
+    if (g_search_debounce_id) {
+        g_source_remove(g_search_debounce_id);
+        g_search_debounce_id = 0;
+    }
+
+    // Whatever was still searching is stale now.
+    leave_updates_view();
+    guint generation = ++g_search_generation;
+    g_search_trace_start = trace_start();
+    if (g_search_process) {
+        terminate_process(g_search_process);
+        g_search_process.reset();
+    }
+    g_search_jobs->cancel_all();
+    if (g_aur_search_job) {
+        g_aur_search_job->cancelled = true;
+        g_aur_search_job.reset();
+    }
+    g_search_source_failed = false;
+
+    std::vector<std::string> terms = split_search_terms(query);
+    bool can_refine = allow_refine && g_shown_query_complete && !terms_need_regex(terms) &&
+                      query_refines(fold_terms(split_search_terms(g_shown_query)),
+                                    fold_terms(terms));
+    g_shown_query = query;
+
+    const PackageList *cached =
+        allow_refine ? g_search_cache.find(search_cache_key(query)) : nullptr;
+    if (cached && !terms.empty()) {
+        PackageList pkgs = *cached;
+        {
+            TraceScope trace("installed checks");
+            for (auto &pkg : pkgs.items) {
+                pkg.set_installed(is_package_installed(pkg.name));
+            }
+        }
+        bool none = pkgs.empty();
+        show_matches(std::move(pkgs));
+        trace_record("search", g_search_trace_start, query + " (cached)");
+        g_search_trace_start = 0;
+        g_shown_query_complete = true;
+        if (none && g_status_label) {
+            gtk_label_set_text(GTK_LABEL(g_status_label), "No results found.");
+        }
+        return;
+    }
+
+    if (can_refine) {
+        refine_results(terms);
+        return;
+    }
+    g_shown_query_complete = false;
+
+    if (terms.empty()) {
+        clear_results();
+        if (g_status_label)
+            gtk_label_set_text(GTK_LABEL(g_status_label), "Ready. Enter a search term.");
+        return;
+    }
+
+    if (g_status_label) {
+        std::string msg = "Searching for \"" + query + "\"...";
+        gtk_label_set_text(GTK_LABEL(g_status_label), msg.c_str());
+    }
+
+    g_search_rows_shown = false;
+    rebuild_catalog_if_stale();
+
+    // Regular expressions only work with pacman's own search, and yay
+    // applies them to the AUR the same way.
+    if (terms_need_regex(terms)) {
+        g_search_sources_pending = 1;
+        std::vector<std::string> argv = { "yay", "-Ss" };
+        argv.insert(argv.end(), terms.begin(), terms.end());
+        search_with_process(argv, generation);
+        return;
+    }
+
+    // Repos from the offline index when it is loaded, otherwise from
+    // pacman (which reads the sync DBs, no network); the AUR from the
+    // metadata dump in the index or, without it, the RPC. Rows show up as
+    // each part answers.
+    bool have_repos = g_catalog && g_catalog->complete;
+    bool need_aur = !catalog_ready();
+    g_search_sources_pending = 1 + (need_aur ? 1 : 0);
+    if (have_repos) {
+        search_catalog(g_catalog, terms, generation);
+    } else {
+        std::vector<std::string> argv = { "pacman", "-Ss" };
+        argv.insert(argv.end(), terms.begin(), terms.end());
+        search_with_process(argv, generation);
+    }
+    if (need_aur) search_aur(terms, generation);
+}
+
+// Enter or the Search button: always a fresh search.
+extern "C" void on_search_activated(GtkWidget *entry, gpointer) {
+    const char *text = gtk_entry_get_text(GTK_ENTRY(entry));
+    if (!text) return;
+    perform_search(text, false);
+}
+
+static gboolean on_search_debounce_elapsed(gpointer) {
+    g_search_debounce_id = 0;
+
+    const char *text = gtk_entry_get_text(GTK_ENTRY(g_search_entry));
+    std::string query = text ? text : "";
+    if (query != g_shown_query) {
+        perform_search(query, true);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+// Search as you type, once the user pauses.
+extern "C" void on_search_changed(GtkEditable *, gpointer) {
+    if (g_search_debounce_id) g_source_remove(g_search_debounce_id);
+    guint delay = catalog_ready() ? SEARCH_DEBOUNCE_INDEX_MS : SEARCH_DEBOUNCE_NETWORK_MS;
+    g_search_debounce_id = g_timeout_add(delay, on_search_debounce_elapsed, nullptr);
+}
+
+// ───────────────────────────────────────────────
+//  System updates
+// ───────────────────────────────────────────────
+
+// The Updates view lists every installed package with a newer version
+// available, in the results list. Like checkupdates(8), the sync DBs are
+// refreshed into a private copy (fakeroot pacman -Sy --dbpath ...) so
+// checking never leaves the system in a half-synced state and needs no
+// sudo. Repo upgrades are then worked out in-process from that copy and
+// the installed index; foreign packages are looked up on the AUR in as few
+// RPC requests as the URL limit allows. Upgrading is one `yay -Syu`.
+
+static bool g_updates_checking = false;
+static GtkWidget *g_upgrade_button = nullptr;
+
+// pacman's version comparison (rpmvercmp in libalpm's version.c), for
+// builds without libalpm. Segments of digits compare numerically, letters
+// alphabetically, and a letter segment sorts before a number ("1.0a" <
+// "1.0.1"); the separators themselves only matter by their count.
+static int rpmvercmp(const std::string &a, const std::string &b) {
+    if (a == b) return 0;
+    const char *one = a.c_str();
+    const char *two = b.c_str();
+    const char *ptr1 = one;
+    const char *ptr2 = two;
+
+    while (*one && *two) {
+        while (*one && !g_ascii_isalnum(*one)) one++;
+        while (*two && !g_ascii_isalnum(*two)) two++;
+        if (!*one || !*two) break;
+
+        // Different separator lengths decide it too.
+        if ((one - ptr1) != (two - ptr2)) return (one - ptr1) < (two - ptr2) ? -1 : 1;
+
+        ptr1 = one;
+        ptr2 = two;
+        bool isnum = g_ascii_isdigit(*ptr1);
+        if (isnum) {
+            while (*ptr1 && g_ascii_isdigit(*ptr1)) ptr1++;
+            while (*ptr2 && g_ascii_isdigit(*ptr2)) ptr2++;
+        } else {
+            while (*ptr1 && g_ascii_isalpha(*ptr1)) ptr1++;
+            while (*ptr2 && g_ascii_isalpha(*ptr2)) ptr2++;
+        }
+
+        // A number against letters: the number is newer.
+        if (two == ptr2) return isnum ? 1 : -1;
+
+        if (isnum) {
+            while (*one == '0' && one + 1 < ptr1) one++;
+            while (*two == '0' && two + 1 < ptr2) two++;
+            if ((ptr1 - one) != (ptr2 - two)) return (ptr1 - one) > (ptr2 - two) ? 1 : -1;
+        }
+
+        std::string_view seg1(one, static_cast<size_t>(ptr1 - one));
+        std::string_view seg2(two, static_cast<size_t>(ptr2 - two));
+        int rc = seg1.compare(seg2);
+        if (rc) return rc < 0 ? -1 : 1;
+
+        one = ptr1;
+        two = ptr2;
+    }
+
+    if (!*one && !*two) return 0;
+    // Whichever has segments left is newer, unless they are letters ("1.0" > "1.0rc").
+    return ((!*one && !g_ascii_isalpha(*two)) || g_ascii_isalpha(*one)) ? -1 : 1;
+}
+
+// Split "epoch:version-release"; a missing epoch is "0", a missing
+// release is left empty.
+static void split_evr(const std::string &evr, std::string &epoch,
+                      std::string &version, std::string &release) {
+    size_t i = 0;
+    while (i < evr.size() && g_ascii_isdigit(evr[i])) i++;
+    size_t start = 0;
+    epoch = "0";
+    if (i < evr.size() && evr[i] == ':') {
+        if (i > 0) epoch = evr.substr(0, i);
+        start = i + 1;
+    }
+    size_t dash = evr.rfind('-');
+    if (dash != std::string::npos && dash >= start) {
+        version = evr.substr(start, dash - start);
+        release = evr.substr(dash + 1);
+    } else {
+        version = evr.substr(start);
+        release.clear();
+    }
+}
+
+// < 0, 0 or > 0 as `a` is older than, the same as or newer than `b`.
+static int vercmp(const std::string &a, const std::string &b) {
+#ifdef COLOSSUS_WITH_ALPM
+    return alpm_pkg_vercmp(a.c_str(), b.c_str());
+#else
+    if (a == b) return 0;
+    std::string epoch1, version1, release1, epoch2, version2, release2;
+    split_evr(a, epoch1, version1, release1);
+    split_evr(b, epoch2, version2, release2);
+    int rc = rpmvercmp(epoch1, epoch2);
+    if (rc == 0) rc = rpmvercmp(version1, version2);
+    if (rc == 0 && !release1.empty() && !release2.empty()) rc = rpmvercmp(release1, release2);
+    return rc;
+#endif
+}
+
+// Our private DB path: sync/ gets refreshed, local/ links to the real one.
+static std::string update_check_dbpath() {
+    gchar *path = g_build_filename(g_get_user_cache_dir(), "colossus-pkgcenter",
+                                   "checkup-db", nullptr);
+    std::string result(path);
+    g_free(path);
+    return result;
+}
+
+// Create the private DB path. Sync DBs it does not have yet are copied
+// from the system (mtimes included), so the refresh only downloads what
+// changed since pacman last synced. Worker thread.
+static bool prepare_update_check_dbpath(const std::string &dbpath) {
+    std::string sync_dir = dbpath + "/sync";
+    if (g_mkdir_with_parents(sync_dir.c_str(), 0755) != 0) return false;
+
+    std::string local = dbpath + "/local";
+    if (!g_file_test(local.c_str(), G_FILE_TEST_EXISTS) &&
+        symlink(PACMAN_LOCAL_DB, local.c_str()) != 0) {
+        return false;
+    }
+
+    for (const auto &db : list_sync_dbs(PACMAN_SYNC_DB)) {
+        std::string target = sync_dir + "/" + db;
+        if (g_file_test(target.c_str(), G_FILE_TEST_EXISTS)) continue;
+        GFile *from = g_file_new_for_path((std::string(PACMAN_SYNC_DB) + "/" + db).c_str());
+        GFile *to = g_file_new_for_path(target.c_str());
+        g_file_copy(from, to, G_FILE_COPY_ALL_METADATA, nullptr, nullptr, nullptr, nullptr);
+        g_object_unref(from);
+        g_object_unref(to);
+    }
+    return true;
+}
+
+// Repo upgrades for `installed` (name → version) from the sync DBs in
+// `dbpath`. Like pacman, the first repo that has a package wins. Installed
+// packages found in no repo are returned in `foreign`. Worker thread.
+static bool find_repo_upgrades(const std::string &dbpath,
+                               const std::unordered_map<std::string, std::string> &installed,
+                               PackageList &upgrades, std::vector<std::string> &foreign) {
+    TraceScope trace("find repo upgrades");
+    std::string sync_dir = dbpath + "/sync";
+    std::vector<std::string> dbs = list_sync_dbs(sync_dir);
+    if (dbs.empty()) return false;
+
+    auto arena = std::make_shared<StringArena>();
+    upgrades.keep_arena(arena);
+    std::unordered_set<std::string> in_sync;
+    std::string key;
+
+#ifdef COLOSSUS_WITH_ALPM
+    alpm_handle_t *handle = open_alpm_handle((dbpath + "/").c_str());
+#endif
+
+    bool ok = true;
+    for (const auto &db : dbs) {
+        std::string repo_name = db.substr(0, db.size() - 3);
+        RepoId repo = intern_repo(repo_name);
+        auto visit = [&](std::string_view name, std::string_view version, std::string_view desc) {
+            key.assign(name.data(), name.size());
+            auto it = installed.find(key);
+            if (it == installed.end() || !in_sync.insert(key).second) return;
+
+            std::string available(version);
+            if (vercmp(available, it->second) <= 0) return;
+            PackageInfo pkg;
+            pkg.repo = repo;
+            pkg.name = arena->store(name);
+            pkg.version = arena->store(it->second + " → " + available);
+            pkg.description = arena->store(desc);
+            pkg.flags = PACKAGE_INSTALLED | PACKAGE_UPGRADE;
+            upgrades.items.push_back(pkg);
+        };
+
+        bool loaded = false;
+#ifdef COLOSSUS_WITH_ALPM
+        if (handle) loaded = alpm_visit_sync_db(handle, repo_name, visit);
+#endif
+        if (!loaded) loaded = visit_sync_db(sync_dir + "/" + db, visit);
+        if (!loaded) {
+            g_printerr("Update check: could not read %s/%s\n", sync_dir.c_str(), db.c_str());
+            ok = false;
+        }
+    }
+
+#ifdef COLOSSUS_WITH_ALPM
+    if (handle) alpm_release(handle);
+#endif
+
+    for (const auto &kv : installed) {
+        if (!in_sync.count(kv.first)) foreign.push_back(kv.first);
+    }
+    std::sort(foreign.begin(), foreign.end());
+    return ok;
+}
+
+// AUR upgrades from RPC "info" replies for foreign packages. Local builds
+// the AUR does not know are simply not in the replies.
+static void add_aur_upgrades(const std::vector<std::string> &replies, PackageList &upgrades) {
+    auto arena = std::make_shared<StringArena>();
+    upgrades.keep_arena(arena);
+    for (const auto &reply : replies) {
+        PackageList found;
+        std::string error;
+        if (!parse_aur_search(reply, {}, found, &error) && !error.empty()) { // no terms: every result
+            g_printerr("AUR info lookup refused: %s\n", error.c_str());
+        }
+        for (const auto &pkg : found.items) {
+            const std::string *local = installed_version(pkg.name);
+            if (!local || vercmp(std::string(pkg.version), *local) <= 0) continue;
+            PackageInfo upgrade = pkg;
+            upgrade.version = arena->store(*local + " → " + std::string(pkg.version));
+            upgrade.flags = PACKAGE_INSTALLED | PACKAGE_UPGRADE;
+            upgrades.items.push_back(upgrade);
+        }
+    }
+}
+
+static void show_updates(PackageList upgrades, const std::string &note) {
+    g_updates_checking = false;
+    if (!g_updates_shown) return; // a search took over meanwhile
+
+    std::sort(upgrades.items.begin(), upgrades.items.end(),
+              [](const PackageInfo &a, const PackageInfo &b) { return a.name < b.name; });
+    size_t count = upgrades.size();
+    show_matches(std::move(upgrades));
+    g_shown_query_complete = true;
+
+    if (g_upgrade_button) {
+        std::string label = "Upgrade All (" + std::to_string(count) + ")";
+        gtk_button_set_label(GTK_BUTTON(g_upgrade_button), label.c_str());
+        gtk_widget_set_visible(g_upgrade_button, count > 0);
+    }
+    if (g_status_label) {
+        std::string status = count == 0 ? "The system is up to date."
+                           : std::to_string(count) + (count == 1 ? " update available." : " updates available.");
+        if (!note.empty()) status += "  | " + note;
+        gtk_label_set_text(GTK_LABEL(g_status_label), status.c_str());
+    }
+}
+
+// Back to searching; the entry's text is what shows next.
+static void leave_updates_view() {
+    if (!g_updates_shown) return;
+    g_updates_shown = false;
+    if (g_upgrade_button) gtk_widget_hide(g_upgrade_button);
+}
+
+// Refresh the private sync DBs, then list what has a newer version.
+static void check_for_updates() {
+    // Take the list over from whatever search was running.
+    ++g_search_generation;
+    if (g_search_debounce_id) {
+        g_source_remove(g_search_debounce_id);
+        g_search_debounce_id = 0;
+    }
+    if (g_search_process) {
+        terminate_process(g_search_process);
+        g_search_process.reset();
+    }
+    g_search_jobs->cancel_all();
+    g_updates_shown = true;
+    g_shown_query.clear();
+    g_shown_query_complete = false;
+    gtk_entry_set_text(GTK_ENTRY(g_search_entry), "");
+    clear_results();
+    if (g_upgrade_button) gtk_widget_hide(g_upgrade_button);
+    if (g_status_label)
+        gtk_label_set_text(GTK_LABEL(g_status_label), "Checking for updates...");
+
+    // One already under way will show its answer here.
+    if (g_updates_checking) return;
+    g_updates_checking = true;
+    gint64 started = trace_start();
+    std::string dbpath = update_check_dbpath();
+
+    auto scan = [dbpath, started](const std::string &note) {
+        if (!g_installed_index_valid) refresh_installed_index();
+        auto installed = std::make_shared<std::unordered_map<std::string, std::string>>(g_installed_index);
+        auto upgrades = std::make_shared<PackageList>();
+        auto foreign = std::make_shared<std::vector<std::string>>();
+        auto ok = std::make_shared<bool>(false);
+
+        auto job = std::make_shared<Job>();
+        job->work = [dbpath, installed, upgrades, foreign, ok](Job &) {
+            *ok = find_repo_upgrades(dbpath, *installed, *upgrades, *foreign);
+        };
+        job->finished = [upgrades, foreign, ok, note, started](Job &) {
+            std::string repo_note = *ok ? note : "Some package databases could not be read.";
+            if (foreign->empty()) {
+                trace_record("update check", started);
+                show_updates(std::move(*upgrades), repo_note);
+                return;
+            }
+            aur_rpc_info(*foreign, [upgrades, repo_note, started](bool aur_ok,
+                                                                  const std::vector<std::string> &replies) {
+                add_aur_upgrades(replies, *upgrades);
+                trace_record("update check", started);
+                std::string note = repo_note;
+                if (!aur_ok) note += std::string(note.empty() ? "" : " ") + "AUR could not be checked.";
+                show_updates(std::move(*upgrades), note);
+            });
+        };
+        g_index_jobs->submit(job);
+    };
+
+    auto prepared = std::make_shared<bool>(false);
+    auto job = std::make_shared<Job>();
+    job->work = [dbpath, prepared](Job &) { *prepared = prepare_update_check_dbpath(dbpath); };
+    job->finished = [dbpath, prepared, scan](Job &) {
+        if (!*prepared) {
+            g_printerr("Update check: cannot set up %s\n", dbpath.c_str());
+            scan("Could not refresh the package databases.");
+            return;
+        }
+        std::vector<std::string> argv = { "fakeroot", "--", "pacman", "-Sy",
+                                          "--dbpath", dbpath, "--logfile", "/dev/null" };
+        ProcessCallbacks callbacks;
+        callbacks.on_stderr = forward_to_stderr("update check");
+        callbacks.on_exit = [scan](bool ok) {
+            scan(ok ? "" : "Could not refresh the package databases; showing the last sync.");
+        };
+        spawn_process(argv, std::move(callbacks));
+    };
+    g_index_jobs->submit(job);
+}
+
+extern "C" void on_updates_clicked(GtkWidget *, gpointer) {
+    check_for_updates();
+}
+
+// Arch does not support partial upgrades, so every upgrade (a row's or
+// the button's) is the whole system, in one transaction.
+extern "C" void on_upgrade_all_clicked(GtkWidget *, gpointer) {
+    if (!transaction_lane_available()) return;
+
+    GtkWidget *dialog = gtk_message_dialog_new(
+        GTK_WINDOW(g_main_window),
+        GTK_DIALOG_MODAL,
+        GTK_MESSAGE_QUESTION,
+        GTK_BUTTONS_OK_CANCEL,
+        "Upgrade the whole system?\n\nThis runs \"yay -Syu\" for %d package(s).",
+        g_results_total
+    );
+    gint response = gtk_dialog_run(GTK_DIALOG(dialog));
+    gtk_widget_destroy(dialog);
+    if (response != GTK_RESPONSE_OK || !sudo_password_available()) return;
+
+    if (g_status_label)
+        gtk_label_set_text(GTK_LABEL(g_status_label), "Upgrading the system...");
+
+    std::vector<std::string> argv = {
+        "yay", "-Syu", "--noconfirm",
+        "--answerclean", "None",
+        "--answerdiff", "None",
+        "--answeredit", "None",
+    };
+    start_transaction(argv, "Upgrading the system...", [](bool ok) {
+        GtkWidget *done = gtk_message_dialog_new(
+            GTK_WINDOW(g_main_window),
+            GTK_DIALOG_MODAL,
+            ok ? GTK_MESSAGE_INFO : GTK_MESSAGE_ERROR,
             GTK_BUTTONS_OK,
-            "No sudo password cached.\nPlease restart the app."
+            ok ?
+              "System upgrade finished." :
+              "The upgrade may have failed.\nCheck the command log or run yay -Syu manually."
         );
-        gtk_dialog_run(GTK_DIALOG(warn));
-        gtk_widget_destroy(warn);
-        return;
+        if (!ok) show_log_hint(done);
+        gtk_dialog_run(GTK_DIALOG(done));
+        gtk_widget_destroy(done);
+
+        // Whatever is left (held back, failed) shows up again.
+        if (g_updates_shown) check_for_updates();
+        else refresh_after_transaction();
+    });
+}
+
+// ───────────────────────────────────────────────
+//  Package cache
+// ───────────────────────────────────────────────
+
+// The "Package Cache" window: what pacman's cache, our download cache and
+// yay's build cache hold, grouped by package, and what a paccache-style
+// policy would free (keep the newest N versions of each package, and
+// optionally nothing of packages that are no longer installed). Scans fan
+// out over a few threads, and every directory listing is remembered with
+// the directory's mtime: a rescan stat()s each directory and only reads
+// the ones that changed, so reopening the window is close to free. yay's
+// build directories are the exception, see scan_cache_dir.
+static const size_t CACHE_SCAN_THREADS = 8;
+static const size_t CACHE_STAT_PARALLEL_MIN = 256;  // new files before stat() fans out
+static const int CACHE_DEFAULT_KEEP = 3;           // as paccache
+
+struct CachedDir {
+    gint64 mtime = -1;
+    std::vector<std::pair<std::string, guint64>> files;   // name, size
+    std::vector<std::string> subdirs;
+};
+
+static std::mutex g_cache_scan_mutex;
+static std::unordered_map<std::string, CachedDir> g_cache_scans;   // by path
+
+static gint64 stat_mtime_ns(const struct stat &st) {
+    return static_cast<gint64>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+// List `path`, or reuse the last listing if the directory has not changed
+// since. Sizes of files seen before are reused as well: pacman and our
+// downloads write a .part file and rename it, so a file that changes is a
+// new entry and bumps the directory's mtime. Not so in yay's build
+// directories (`rewritten`), where `makepkg -f` rewrites same-named
+// packages in place: those are listed and every file stat()ed each time.
+// Any thread.
+static CachedDir scan_cache_dir(const std::string &path, bool parallel, bool rewritten = false) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) return CachedDir();
+    gint64 mtime = stat_mtime_ns(st);
+
+    std::unordered_map<std::string, guint64> known;
+    if (!rewritten) {
+        std::lock_guard<std::mutex> lock(g_cache_scan_mutex);
+        auto it = g_cache_scans.find(path);
+        if (it != g_cache_scans.end()) {
+            if (it->second.mtime == mtime) return it->second;
+            for (const auto &file : it->second.files) known.emplace(file.first, file.second);
+        }
+    }
+
+    CachedDir dir;
+    dir.mtime = mtime;
+    std::vector<size_t> unknown;   // files that still need a stat()
+    if (DIR *d = opendir(path.c_str())) {
+        while (struct dirent *entry = readdir(d)) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+            unsigned char type = entry->d_type;
+            if (type == DT_UNKNOWN) {
+                struct stat est;
+                if (lstat((path + "/" + entry->d_name).c_str(), &est) != 0) continue;
+                type = S_ISDIR(est.st_mode) ? DT_DIR : S_ISREG(est.st_mode) ? DT_REG : DT_UNKNOWN;
+            }
+            if (type == DT_DIR) {
+                dir.subdirs.push_back(entry->d_name);
+            } else if (type == DT_REG) {
+                auto it = known.find(entry->d_name);
+                dir.files.emplace_back(entry->d_name, it != known.end() ? it->second : 0);
+                if (it == known.end()) unknown.push_back(dir.files.size() - 1);
+            }
+        }
+        closedir(d);
+    }
+
+    size_t threads = parallel && unknown.size() >= CACHE_STAT_PARALLEL_MIN ? CACHE_SCAN_THREADS : 1;
+    parallel_for(unknown.size(), threads, [&](size_t i) {
+        auto &file = dir.files[unknown[i]];
+        struct stat fst;
+        if (stat((path + "/" + file.first).c_str(), &fst) == 0) {
+            file.second = static_cast<guint64>(fst.st_size);
+        }
+    });
+
+    std::lock_guard<std::mutex> lock(g_cache_scan_mutex);
+    g_cache_scans[path] = dir;
+    return dir;
+}
+
+// Bytes in `dir` (listed from `path`) and below.
+static guint64 cache_tree_size(const std::string &path, const CachedDir &dir, bool rewritten) {
+    guint64 total = 0;
+    for (const auto &file : dir.files) total += file.second;
+    for (const auto &sub : dir.subdirs) {
+        std::string sub_path = path + "/" + sub;
+        total += cache_tree_size(sub_path, scan_cache_dir(sub_path, false, rewritten), rewritten);
+    }
+    return total;
+}
+
+// "name-1:2.0-1-x86_64.pkg.tar.zst" -> name, "1:2.0-1". False for
+// signatures, partial downloads and anything else.
+static bool parse_package_file(const std::string &file, std::string &name, std::string &version) {
+    size_t ext = file.find(".pkg.tar");
+    if (ext == std::string::npos || g_str_has_suffix(file.c_str(), ".sig") ||
+        g_str_has_suffix(file.c_str(), ".part")) {
+        return false;
+    }
+    std::string stem = file.substr(0, ext);
+    size_t arch = stem.rfind('-');
+    if (arch == std::string::npos || arch == 0) return false;
+    size_t rel = stem.rfind('-', arch - 1);
+    if (rel == std::string::npos || rel == 0) return false;
+    size_t ver = stem.rfind('-', rel - 1);
+    if (ver == std::string::npos || ver == 0) return false;
+    name = stem.substr(0, ver);
+    version = stem.substr(ver + 1, arch - ver - 1);
+    return true;
+}
+
+struct CacheRoot {
+    std::string path;
+    std::string label;
+    bool yay = false;          // one build directory per package base
+    bool needs_root = false;   // not ours to delete from: sudo rm
+};
+
+struct CacheArtifact {
+    enum Kind { Package, BuildDir } kind = Package;
+    std::string path;
+    std::string name;          // package name, or the yay package base
+    std::string version;       // packages only
+    guint64 size = 0;          // a BuildDir's own bytes, not its packages'
+    bool signature = false;    // path + ".sig" goes with it
+    size_t root = 0;
+    size_t parent = SIZE_MAX;  // the BuildDir a package sits in
+    bool prune = false;
+};
+
+struct CacheScan {
+    std::vector<CacheRoot> roots;
+    std::vector<CacheArtifact> artifacts;
+    guint64 total = 0;
+};
+
+// Main thread (reads pacman.conf and the environment).
+static std::vector<CacheRoot> cache_roots() {
+    std::vector<CacheRoot> roots;
+    auto add = [&roots](std::string path, const char *label, bool yay) {
+        while (path.size() > 1 && path.back() == '/') path.pop_back();
+        if (!g_file_test(path.c_str(), G_FILE_TEST_IS_DIR)) return;
+        for (const auto &root : roots) {
+            if (root.path == path) return;
+        }
+        roots.push_back({ path, label, yay, access(path.c_str(), W_OK) != 0 });
+    };
+    add(read_pacman_options().cache_dir, "pacman", false);
+    add(download_cache_dir(), "downloads", false);
+    gchar *yay = g_build_filename(g_get_user_cache_dir(), "yay", nullptr);
+    add(yay, "yay", true);
+    g_free(yay);
+    return roots;
+}
+
+static guint64 add_package_files(const std::string &dir_path, const CachedDir &dir,
+                                 size_t root, size_t parent, CacheScan &scan) {
+    std::unordered_map<std::string, guint64> signatures;
+    for (const auto &file : dir.files) {
+        if (g_str_has_suffix(file.first.c_str(), ".sig")) {
+            signatures[file.first.substr(0, file.first.size() - 4)] = file.second;
+        }
+    }
+
+    guint64 bytes = 0;
+    for (const auto &file : dir.files) {
+        CacheArtifact pkg;
+        if (!parse_package_file(file.first, pkg.name, pkg.version)) continue;
+        pkg.path = dir_path + "/" + file.first;
+        pkg.size = file.second;
+        auto sig = signatures.find(file.first);
+        if (sig != signatures.end()) {
+            pkg.size += sig->second;
+            pkg.signature = true;
+        }
+        pkg.root = root;
+        pkg.parent = parent;
+        bytes += pkg.size;
+        scan.artifacts.push_back(std::move(pkg));
     }
+    return bytes;
+}
 
-    GtkWidget *dialog = gtk_message_dialog_new(
-        GTK_WINDOW(g_main_window),
-        GTK_DIALOG_MODAL,
-        GTK_MESSAGE_QUESTION,
-        GTK_BUTTONS_OK_CANCEL,
-        "Remove package \"%s\"?\n\nThis will also remove unused dependencies.",
-        pkg_name.c_str()
-    );
-    gint response = gtk_dialog_run(GTK_DIALOG(dialog));
-    gtk_widget_destroy(dialog);
+// Worker thread.
+static CacheScan scan_package_caches(std::vector<CacheRoot> roots) {
+    TraceScope trace("cache scan");
+    CacheScan scan;
+    scan.roots = std::move(roots);
+
+    for (size_t r = 0; r < scan.roots.size(); r++) {
+        const CacheRoot &root = scan.roots[r];
+        CachedDir top = scan_cache_dir(root.path, true);
+        for (const auto &file : top.files) scan.total += file.second;
+
+        if (!root.yay) {
+            add_package_files(root.path, top, r, SIZE_MAX, scan);
+            for (const auto &sub : top.subdirs) {
+                std::string path = root.path + "/" + sub;
+                scan.total += cache_tree_size(path, scan_cache_dir(path, false), false);
+            }
+            continue;
+        }
 
-    if (response != GTK_RESPONSE_OK) {
-        return;
+        // yay: a directory per package base, each walked on its own thread.
+        std::vector<CachedDir> listings(top.subdirs.size());
+        std::vector<guint64> sizes(top.subdirs.size());
+        parallel_for(top.subdirs.size(), CACHE_SCAN_THREADS, [&](size_t i) {
+            std::string path = root.path + "/" + top.subdirs[i];
+            listings[i] = scan_cache_dir(path, false, true);
+            sizes[i] = cache_tree_size(path, listings[i], true);
+        });
+        for (size_t i = 0; i < top.subdirs.size(); i++) {
+            CacheArtifact dir;
+            dir.kind = CacheArtifact::BuildDir;
+            dir.path = root.path + "/" + top.subdirs[i];
+            dir.name = top.subdirs[i];
+            dir.root = r;
+            size_t index = scan.artifacts.size();
+            scan.artifacts.push_back(dir);
+
+            guint64 packages = add_package_files(dir.path, listings[i], r, index, scan);
+            scan.artifacts[index].size = sizes[i] > packages ? sizes[i] - packages : 0;
+            scan.total += sizes[i];
+        }
     }
+    return scan;
+}
 
-    if (g_status_label) {
-        std::string msg = "Removing " + pkg_name + "...";
-        gtk_label_set_text(GTK_LABEL(g_status_label), msg.c_str());
+// paccache's rule, per package and cache: keep the `keep` newest versions.
+// With `uninstalled`, keep nothing of packages that are not installed,
+// including yay build directories none of whose packages are installed.
+static void apply_cache_policy(CacheScan &scan, int keep, bool uninstalled) {
+    auto &arts = scan.artifacts;
+    std::unordered_map<std::string, std::vector<size_t>> groups;
+    std::vector<bool> dir_in_use(arts.size(), false);
+    for (size_t i = 0; i < arts.size(); i++) {
+        arts[i].prune = false;
+        if (arts[i].kind != CacheArtifact::Package) continue;
+        groups[std::to_string(arts[i].root) + "/" + arts[i].name].push_back(i);
+        if (arts[i].parent != SIZE_MAX && is_package_installed(arts[i].name)) {
+            dir_in_use[arts[i].parent] = true;
+        }
     }
 
-    GtkWidget *info = gtk_message_dialog_new(
-        GTK_WINDOW(g_main_window),
-        GTK_DIALOG_MODAL,
-        GTK_MESSAGE_INFO,
-        GTK_BUTTONS_NONE,
-        "Removing %s...\n\nThis may take a moment.",
-        pkg_name.c_str()
-    );
-    gtk_widget_show_all(info);
+    for (auto &kv : groups) {
+        auto &items = kv.second;
+        std::sort(items.begin(), items.end(), [&arts](size_t a, size_t b) {
+            return vercmp(arts[a].version, arts[b].version) > 0;
+        });
+        bool gone = uninstalled && !is_package_installed(arts[items.front()].name);
+        for (size_t k = 0; k < items.size(); k++) {
+            arts[items[k]].prune = gone || k >= static_cast<size_t>(keep);
+        }
+    }
 
-    // Pre-auth sudo
-    bool auth_ok = run_sudo_with_password(
-        g_sudo_password,
-        "sudo -S -v"
-    );
+    for (size_t i = 0; i < arts.size(); i++) {
+        if (arts[i].kind != CacheArtifact::BuildDir) continue;
+        arts[i].prune = uninstalled && !dir_in_use[i] && !is_package_installed(arts[i].name);
+    }
+    // Whatever sits in a directory that goes, goes with it.
+    for (auto &art : arts) {
+        if (art.parent != SIZE_MAX && arts[art.parent].prune) art.prune = true;
+    }
+}
 
-    bool ok = false;
-    if (auth_ok) {
-        // Remove package and unused dependencies.
-        std::string cmd =
-            "yay -Rns --noconfirm " + pkg_name;
+enum { CACHE_COL_NAME, CACHE_COL_WHERE, CACHE_COL_SIZE, CACHE_COL_RECLAIM, CACHE_N_COLS };
+enum { CACHE_RESPONSE_DELETE = 1 };
+
+struct CacheManager {
+    CacheScan scan;
+    GtkWidget *dialog = nullptr;
+    GtkWidget *summary = nullptr;
+    GtkWidget *keep_spin = nullptr;
+    GtkWidget *uninstalled_check = nullptr;
+    GtkTreeStore *store = nullptr;
+};
 
-        ok = run_command_status(cmd);
+// Re-apply the policy and refill the tree: one row per package and cache
+// (or yay build directory), most reclaimable first, versions below it.
+static void refresh_cache_manager(CacheManager &m) {
+    int keep = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(m.keep_spin));
+    bool uninstalled = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(m.uninstalled_check));
+    apply_cache_policy(m.scan, keep, uninstalled);
+
+    struct Group {
+        std::vector<size_t> items;
+        guint64 size = 0;
+        guint64 reclaim = 0;
+    };
+    std::unordered_map<std::string, Group> by_key;
+    guint64 reclaim = 0;
+    size_t files = 0;
+    const auto &arts = m.scan.artifacts;
+    for (size_t i = 0; i < arts.size(); i++) {
+        const CacheArtifact &art = arts[i];
+        std::string key = art.kind == CacheArtifact::BuildDir
+                        ? "dir:" + art.path
+                        : std::to_string(art.root) + "/" + art.name;
+        Group &group = by_key[key];
+        group.items.push_back(i);
+        group.size += art.size;
+        if (art.prune) {
+            group.reclaim += art.size;
+            reclaim += art.size;
+            files++;
+        }
+    }
+    std::vector<Group *> groups;
+    for (auto &kv : by_key) groups.push_back(&kv.second);
+    std::sort(groups.begin(), groups.end(), [&arts](const Group *a, const Group *b) {
+        if (a->reclaim != b->reclaim) return a->reclaim > b->reclaim;
+        return arts[a->items.front()].name < arts[b->items.front()].name;
+    });
+
+    gtk_tree_store_clear(m.store);
+    for (const Group *group : groups) {
+        const CacheArtifact &first = arts[group->items.front()];
+        const CacheRoot &root = m.scan.roots[first.root];
+        std::string where = first.kind == CacheArtifact::BuildDir ? "yay build files" : root.label;
+        std::string size = format_size(static_cast<gint64>(group->size));
+        std::string freed = group->reclaim ? format_size(static_cast<gint64>(group->reclaim)) : "";
+        GtkTreeIter parent;
+        gtk_tree_store_insert_with_values(m.store, &parent, nullptr, -1,
+                                          CACHE_COL_NAME, first.name.c_str(),
+                                          CACHE_COL_WHERE, where.c_str(),
+                                          CACHE_COL_SIZE, size.c_str(),
+                                          CACHE_COL_RECLAIM, freed.c_str(),
+                                          -1);
+        if (first.kind == CacheArtifact::BuildDir) continue;
+        for (size_t i : group->items) {
+            std::string item_size = format_size(static_cast<gint64>(arts[i].size));
+            gtk_tree_store_insert_with_values(m.store, nullptr, &parent, -1,
+                                              CACHE_COL_NAME, arts[i].version.c_str(),
+                                              CACHE_COL_SIZE, item_size.c_str(),
+                                              CACHE_COL_RECLAIM, arts[i].prune ? "remove" : "",
+                                              -1);
+        }
     }
 
-    gtk_widget_destroy(info);
+    std::string text = format_size(static_cast<gint64>(m.scan.total)) + " cached, " +
+                       format_size(static_cast<gint64>(reclaim)) + " reclaimable in " +
+                       std::to_string(files) + (files == 1 ? " item." : " items.");
+    gtk_label_set_text(GTK_LABEL(m.summary), text.c_str());
+    std::string button = "_Delete " + format_size(static_cast<gint64>(reclaim));
+    GtkWidget *del = gtk_dialog_get_widget_for_response(GTK_DIALOG(m.dialog), CACHE_RESPONSE_DELETE);
+    gtk_button_set_label(GTK_BUTTON(del), button.c_str());
+    gtk_widget_set_sensitive(del, files > 0);
+}
 
-    GtkWidget *done = gtk_message_dialog_new(
-        GTK_WINDOW(g_main_window),
-        GTK_DIALOG_MODAL,
-        ok ? GTK_MESSAGE_INFO : GTK_MESSAGE_ERROR,
-        GTK_BUTTONS_OK,
-        ok ?
-          "Removal finished.\nRe-run the search to see the updated status." :
-          "Removal may have failed.\nCheck terminal logs or run yay manually."
-    );
-    gtk_dialog_run(GTK_DIALOG(done));
-    gtk_widget_destroy(done);
+extern "C" void on_cache_policy_changed(GtkWidget *, gpointer user_data) {
+    refresh_cache_manager(*static_cast<CacheManager *>(user_data));
+}
 
-    const char *current_query = gtk_entry_get_text(GTK_ENTRY(g_search_entry));
-    if (current_query && *current_query) {
-        perform_search(current_query);
-    } else if (g_status_label) {
-        gtk_label_set_text(GTK_LABEL(g_status_label),
-                           "Ready. Enter a search term.");
+// `rm -rf` for one path in a cache of ours; symlinks are removed, not
+// followed. Worker thread.
+static bool remove_cache_path(const std::string &path) {
+    struct stat st;
+    if (lstat(path.c_str(), &st) != 0) return errno == ENOENT;
+    if (!S_ISDIR(st.st_mode)) return unlink(path.c_str()) == 0 || errno == ENOENT;
+
+    bool ok = true;
+    if (DIR *d = opendir(path.c_str())) {
+        while (struct dirent *entry = readdir(d)) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+            if (!remove_cache_path(path + "/" + entry->d_name)) ok = false;
+        }
+        closedir(d);
     }
+    if (rmdir(path.c_str()) != 0) ok = false;
+    return ok;
 }
 
-extern "C" void on_clean_orphans_clicked(GtkWidget *button, gpointer user_data) {
-    (void)button;
-    (void)user_data;
+// Remove what the policy picked, on the transaction lane so no build
+// writes into a cache meanwhile. Our own caches are deleted directly on a
+// worker thread; only the system cache takes a (single) `sudo rm`.
+static void delete_cache_artifacts(const CacheScan &scan, guint64 bytes) {
+    auto own = std::make_shared<std::vector<std::string>>();
+    std::vector<std::string> system;
+    for (const auto &art : scan.artifacts) {
+        if (!art.prune) continue;
+        if (art.parent != SIZE_MAX && scan.artifacts[art.parent].prune) continue; // goes with the dir
+        auto &list = scan.roots[art.root].needs_root ? system : *own;
+        list.push_back(art.path);
+        if (art.signature) list.push_back(art.path + ".sig");
+    }
+    if (own->empty() && system.empty()) return;
+    if (!system.empty() && !sudo_password_available()) {
+        if (g_status_label) gtk_label_set_text(GTK_LABEL(g_status_label), "Package cache cleanup cancelled.");
+        return;
+    }
 
-    if (g_sudo_password.empty()) {
-        GtkWidget *warn = gtk_message_dialog_new(
+    auto failed = std::make_shared<bool>(false);
+    auto report = [failed, bytes] {
+        std::string freed = format_size(static_cast<gint64>(bytes));
+        GtkWidget *done = gtk_message_dialog_new(
             GTK_WINDOW(g_main_window),
             GTK_DIALOG_MODAL,
-            GTK_MESSAGE_ERROR,
+            *failed ? GTK_MESSAGE_ERROR : GTK_MESSAGE_INFO,
             GTK_BUTTONS_OK,
-            "No sudo password cached.\nPlease restart the app."
+            *failed ? "Some cached files could not be deleted.\nCheck the command log."
+                    : "Package cache cleaned, %s freed.",
+            freed.c_str()
         );
-        gtk_dialog_run(GTK_DIALOG(warn));
-        gtk_widget_destroy(warn);
-        return;
+        if (*failed) show_log_hint(done);
+        gtk_dialog_run(GTK_DIALOG(done));
+        gtk_widget_destroy(done);
+        if (g_status_label) gtk_label_set_text(GTK_LABEL(g_status_label), "Package cache cleaned.");
+    };
+
+    if (!own->empty()) {
+        g_transactions.submit([own, failed](std::function<void()> done) {
+            auto failures = std::make_shared<std::atomic<size_t>>(0);
+            auto job = std::make_shared<Job>();
+            job->work = [own, failures](Job &) {
+                TraceScope trace("delete cache files", std::to_string(own->size()));
+                parallel_for(own->size(), CACHE_SCAN_THREADS, [&](size_t i) {
+                    if (!remove_cache_path((*own)[i])) (*failures)++;
+                });
+            };
+            job->finished = [failures, failed, done](Job &) {
+                if (*failures > 0) {
+                    g_printerr("Package cache: %zu paths could not be deleted\n", failures->load());
+                    *failed = true;
+                }
+                done();
+            };
+            g_index_jobs->submit(job);
+        });
     }
 
-    GtkWidget *dialog = gtk_message_dialog_new(
-        GTK_WINDOW(g_main_window),
-        GTK_DIALOG_MODAL,
-        GTK_MESSAGE_QUESTION,
-        GTK_BUTTONS_OK_CANCEL,
-        "Clean up orphaned packages?\n\nThis runs \"yay -Yc --noconfirm\" to remove unused dependencies."
-    );
-    gint response = gtk_dialog_run(GTK_DIALOG(dialog));
-    gtk_widget_destroy(dialog);
-
-    if (response != GTK_RESPONSE_OK) {
+    if (system.empty()) {
+        g_transactions.submit([report](std::function<void()> done) {
+            report();
+            done();
+        });
         return;
     }
+    std::vector<std::string> argv = { "sudo", "-S", "rm", "-rf", "--" };
+    argv.insert(argv.end(), system.begin(), system.end());
+    start_transaction(argv, "Cleaning the system package cache...", [failed, report](bool ok) {
+        if (!ok) *failed = true;
+        report();
+    }, true);
+}
 
-    if (g_status_label) {
-        gtk_label_set_text(GTK_LABEL(g_status_label),
-                           "Cleaning orphaned packages...");
+static void run_cache_manager(CacheScan scan) {
+    CacheManager m;
+    m.scan = std::move(scan);
+    m.dialog = gtk_dialog_new_with_buttons("Package Cache", GTK_WINDOW(g_main_window),
+                                           GTK_DIALOG_MODAL,
+                                           "_Close", GTK_RESPONSE_CLOSE,
+                                           "_Delete", CACHE_RESPONSE_DELETE,
+                                           nullptr);
+    gtk_window_set_default_size(GTK_WINDOW(m.dialog), 640, 480);
+
+    GtkWidget *content = gtk_dialog_get_content_area(GTK_DIALOG(m.dialog));
+    gtk_box_set_spacing(GTK_BOX(content), 6);
+
+    GtkWidget *policy = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    gtk_box_pack_start(GTK_BOX(policy), gtk_label_new("Keep the newest"), FALSE, FALSE, 0);
+    m.keep_spin = gtk_spin_button_new_with_range(0, 10, 1);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(m.keep_spin), CACHE_DEFAULT_KEEP);
+    gtk_box_pack_start(GTK_BOX(policy), m.keep_spin, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(policy), gtk_label_new("versions of each package"), FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(content), policy, FALSE, FALSE, 0);
+
+    m.uninstalled_check = gtk_check_button_new_with_label(
+        "Remove everything cached for packages that are no longer installed");
+    gtk_box_pack_start(GTK_BOX(content), m.uninstalled_check, FALSE, FALSE, 0);
+
+    m.store = gtk_tree_store_new(CACHE_N_COLS, G_TYPE_STRING, G_TYPE_STRING,
+                                 G_TYPE_STRING, G_TYPE_STRING);
+    GtkWidget *view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(m.store));
+    g_object_unref(m.store); // the view holds it now
+
+    GtkTreeViewColumn *name_col = gtk_tree_view_column_new_with_attributes(
+        "Package", gtk_cell_renderer_text_new(), "text", CACHE_COL_NAME, nullptr);
+    gtk_tree_view_column_set_expand(name_col, TRUE);
+    gtk_tree_view_append_column(GTK_TREE_VIEW(view), name_col);
+    gtk_tree_view_append_column(GTK_TREE_VIEW(view), gtk_tree_view_column_new_with_attributes(
+        "Cache", gtk_cell_renderer_text_new(), "text", CACHE_COL_WHERE, nullptr));
+    gtk_tree_view_append_column(GTK_TREE_VIEW(view), gtk_tree_view_column_new_with_attributes(
+        "Size", gtk_cell_renderer_text_new(), "text", CACHE_COL_SIZE, nullptr));
+    gtk_tree_view_append_column(GTK_TREE_VIEW(view), gtk_tree_view_column_new_with_attributes(
+        "Reclaimable", gtk_cell_renderer_text_new(), "text", CACHE_COL_RECLAIM, nullptr));
+
+    GtkWidget *scroll = gtk_scrolled_window_new(nullptr, nullptr);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll),
+                                   GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    gtk_container_add(GTK_CONTAINER(scroll), view);
+    gtk_box_pack_start(GTK_BOX(content), scroll, TRUE, TRUE, 0);
+
+    m.summary = gtk_label_new("");
+    gtk_label_set_xalign(GTK_LABEL(m.summary), 0.0);
+    gtk_box_pack_start(GTK_BOX(content), m.summary, FALSE, FALSE, 0);
+
+    refresh_cache_manager(m);
+    g_signal_connect(m.keep_spin, "value-changed", G_CALLBACK(on_cache_policy_changed), &m);
+    g_signal_connect(m.uninstalled_check, "toggled", G_CALLBACK(on_cache_policy_changed), &m);
+
+    gtk_widget_show_all(m.dialog);
+    gint response = gtk_dialog_run(GTK_DIALOG(m.dialog));
+    gtk_widget_destroy(m.dialog);
+    if (response != CACHE_RESPONSE_DELETE || !transaction_lane_available()) return;
+
+    guint64 bytes = 0;
+    for (const auto &art : m.scan.artifacts) {
+        if (art.prune) bytes += art.size;
     }
+    if (g_status_label) gtk_label_set_text(GTK_LABEL(g_status_label), "Cleaning the package cache...");
+    delete_cache_artifacts(m.scan, bytes);
+}
 
-    GtkWidget *info = gtk_message_dialog_new(
-        GTK_WINDOW(g_main_window),
-        GTK_DIALOG_MODAL,
-        GTK_MESSAGE_INFO,
-        GTK_BUTTONS_NONE,
-        "Cleaning orphaned packages...\n\nThis may take a moment.",
-        nullptr
-    );
-    gtk_widget_show_all(info);
+extern "C" void on_package_cache_clicked(GtkWidget *, gpointer) {
+    if (g_status_label) gtk_label_set_text(GTK_LABEL(g_status_label), "Scanning package caches...");
+
+    auto roots = cache_roots();
+    auto scan = std::make_shared<CacheScan>();
+    auto job = std::make_shared<Job>();
+    job->work = [roots, scan](Job &) { *scan = scan_package_caches(roots); };
+    job->finished = [scan](Job &) {
+        if (g_status_label) {
+            std::string text = "Package caches: " + format_size(static_cast<gint64>(scan->total)) + ".";
+            gtk_label_set_text(GTK_LABEL(g_status_label), text.c_str());
+        }
+        run_cache_manager(std::move(*scan));
+    };
+    g_index_jobs->submit(job);
+}
 
-    bool auth_ok = run_sudo_with_password(
-        g_sudo_password,
-        "sudo -S -v"
-    );
+// ───────────────────────────────────────────────
+//  Package details
+// ───────────────────────────────────────────────
 
-    bool ok = false;
-    if (auth_ok) {
-        ok = run_command_status("yay -Yc --noconfirm");
-    }
+// The pane next to the results shows what `yay -Ss` leaves out (sizes,
+// dependencies, install date, ...) for the row under the cursor. Details
+// are fetched only when asked for: `pacman -Qi` for installed packages,
+// `pacman -Si` for sync packages and the AUR RPC (aur_rpc_info) for the rest. Requests
+// made in the same main-loop turn (the cursor row plus its neighbours,
+// which are prefetched) share one call per source.
+struct PackageDetails {
+    std::vector<std::pair<std::string, std::string>> fields; // label, value
+};
+using PackageDetailsPtr = std::shared_ptr<const PackageDetails>;
 
-    gtk_widget_destroy(info);
+enum class DetailsSource { Local, Sync, Aur };
 
-    GtkWidget *done = gtk_message_dialog_new(
-        GTK_WINDOW(g_main_window),
-        GTK_DIALOG_MODAL,
-        ok ? GTK_MESSAGE_INFO : GTK_MESSAGE_ERROR,
-        GTK_BUTTONS_OK,
-        ok ?
-          "Orphan cleanup finished." :
-          "Cleanup may have failed.\nCheck terminal logs or run yay -Yc manually."
-    );
-    gtk_dialog_run(GTK_DIALOG(done));
-    gtk_widget_destroy(done);
+struct DetailsRequest {
+    std::string key;    // see details_key
+    std::string name;
+    std::string target; // what the source is asked for ("repo/name" for -Si)
+};
 
-    if (g_status_label) {
-        gtk_label_set_text(GTK_LABEL(g_status_label),
-                           "Orphan cleanup complete. You can search again.");
-    }
+// Entries beyond this many are dropped wholesale; they are cheap to refetch.
+static const size_t DETAILS_CACHE_MAX = 2048;
+// Rows above and below the cursor to prefetch.
+static const int DETAILS_PREFETCH_ROWS = 2;
+
+static GtkWidget *g_details_label = nullptr;
+static std::unordered_map<std::string, PackageDetailsPtr> g_details_cache;
+static std::unordered_set<std::string> g_details_pending;
+static std::vector<DetailsRequest> g_details_queue[3]; // by DetailsSource
+static guint g_details_flush_id = 0;
+
+// What the pane shows, so a reply for it can be rendered when it lands.
+static std::string g_details_shown_key;
+static PackageInfo g_details_shown_pkg;
+static std::string g_details_shown_strings[3]; // backs g_details_shown_pkg's views
+
+// Installed packages are described by the local DB, so that is part of the key.
+static std::string details_key(const PackageInfo &pkg) {
+    return std::string(pkg.name) + '\n' + std::string(pkg.version) + (pkg.installed() ? "\nQ" : "\nS");
 }
 
-// ───────────────────────────────────────────────
-//  UI helpers
-// ───────────────────────────────────────────────
+static DetailsSource details_source(const PackageInfo &pkg) {
+    if (pkg.installed()) return DetailsSource::Local;
+    return pkg.repo_name() == "aur" ? DetailsSource::Aur : DetailsSource::Sync;
+}
 
-void clear_results() {
-    GList *children = gtk_container_get_children(GTK_CONTAINER(g_results_list));
-    for (GList *iter = children; iter != nullptr; iter = iter->next) {
-        gtk_widget_destroy(GTK_WIDGET(iter->data));
+// `pacman -Qi/-Si` output: "Key : value" lines, long values wrapped onto
+// indented continuation lines, one blank-line separated block per package.
+static void parse_pacman_info(const std::string &out,
+                              std::unordered_map<std::string, PackageDetails> &by_name) {
+    // Shown in the pane's header already, or not interesting.
+    static const char *const skipped[] = { "Name", "Version", "Description", "Validated By" };
+
+    std::istringstream in(out);
+    std::string line, name;
+    PackageDetails current;
+    bool continues_field = false; // continuation lines belong to fields.back()
+    auto flush = [&]() {
+        if (!name.empty()) by_name[name] = std::move(current);
+        current = PackageDetails();
+        name.clear();
+    };
+
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            flush();
+            continue;
+        }
+        if (line[0] == ' ') {
+            size_t start = line.find_first_not_of(' ');
+            if (continues_field && start != std::string::npos)
+                current.fields.back().second += "\n" + line.substr(start);
+            continue;
+        }
+        continues_field = false;
+        size_t colon = line.find(" : ");
+        if (colon == std::string::npos) continue;
+        std::string key = line.substr(0, line.find_last_not_of(' ', colon) + 1);
+        std::string value = line.substr(colon + 3);
+        if (key == "Name") name = value;
+        if (std::find(std::begin(skipped), std::end(skipped), key) != std::end(skipped)) continue;
+        if (value == "None") continue;
+        current.fields.emplace_back(std::move(key), std::move(value));
+        continues_field = true;
     }
-    g_list_free(children);
+    flush();
 }
 
-GtkWidget* create_package_row(const PackageInfo &pkg) {
-    // Outer vbox = content + separator
-    GtkWidget *outer = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
-    gtk_widget_set_margin_top(outer, 2);
-    gtk_widget_set_margin_bottom(outer, 2);
-    gtk_widget_set_margin_start(outer, 8);
-    gtk_widget_set_margin_end(outer, 8);
+static std::string format_unix_date(const std::string &seconds) {
+    GDateTime *dt = g_date_time_new_from_unix_local(g_ascii_strtoll(seconds.c_str(), nullptr, 10));
+    if (!dt) return seconds;
+    gchar *text = g_date_time_format(dt, "%Y-%m-%d");
+    std::string out = text ? text : seconds;
+    g_free(text);
+    g_date_time_unref(dt);
+    return out;
+}
 
-    // Row content: HBox (icon + text + button)
-    GtkWidget *row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
+// An AUR RPC "info" reply, with labels matching pacman's where they overlap.
+static void parse_aur_details(const std::string &json,
+                              std::unordered_map<std::string, PackageDetails> &by_name) {
+    static const std::pair<const char *, const char *> labels[] = {
+        { "URL", "URL" },
+        { "License", "Licenses" },
+        { "Depends", "Depends On" },
+        { "MakeDepends", "Make Deps" },
+        { "OptDepends", "Optional Deps" },
+        { "Maintainer", "Maintainer" },
+        { "NumVotes", "Votes" },
+        { "Popularity", "Popularity" },
+        { "OutOfDate", "Out Of Date" },
+        { "FirstSubmitted", "First Submitted" },
+        { "LastModified", "Last Modified" },
+    };
+
+    JsonReader reader(json.data(), json.data() + json.size());
+    if (!reader.consume('{') || reader.consume('}')) return;
+
+    std::string key, value, name;
+    do {
+        if (!reader.read_string(key) || !reader.consume(':')) return;
+        if (key != "results") {
+            if (!reader.skip_value()) return;
+            continue;
+        }
+        if (!reader.consume('[')) return;
+        if (reader.consume(']')) continue;
+        do {
+            if (!reader.consume('{')) return;
+            std::unordered_map<std::string, std::string> values;
+            name.clear();
+            if (!reader.consume('}')) {
+                do {
+                    if (!reader.read_string(key) || !reader.consume(':')) return;
+                    if (reader.peek() == '[') {
+                        // A list of strings: one per line, as pacman prints them.
+                        reader.consume('[');
+                        std::string joined;
+                        if (!reader.consume(']')) {
+                            do {
+                                if (!reader.read_scalar(value)) return;
+                                if (!joined.empty()) joined += "\n";
+                                joined += value;
+                            } while (reader.consume(','));
+                            if (!reader.consume(']')) return;
+                        }
+                        value = joined;
+                    } else if (!reader.read_scalar(value)) {
+                        return;
+                    }
+                    if (key == "Name") name = value;
+                    values[key] = value;
+                } while (reader.consume(','));
+                if (!reader.consume('}')) return;
+            }
+            if (name.empty()) continue;
+
+            PackageDetails details;
+            details.fields.emplace_back("Repository", "aur");
+            for (const auto &label : labels) {
+                auto it = values.find(label.first);
+                if (it == values.end() || it->second.empty()) continue;
+                std::string v = it->second;
+                if (strcmp(label.first, "FirstSubmitted") == 0 || strcmp(label.first, "LastModified") == 0 ||
+                    strcmp(label.first, "OutOfDate") == 0) {
+                    v = format_unix_date(v);
+                }
+                details.fields.emplace_back(label.second, v);
+            }
+            by_name[name] = std::move(details);
+        } while (reader.consume(','));
+        if (!reader.consume(']')) return;
+    } while (reader.consume(','));
+}
 
-    // Icon
-    GtkWidget *icon = nullptr;
-    GtkIconTheme *theme = gtk_icon_theme_get_default();
-    if (gtk_icon_theme_has_icon(theme, pkg.name.c_str())) {
-        icon = gtk_image_new_from_icon_name(pkg.name.c_str(), GTK_ICON_SIZE_DIALOG);
-    } else {
-        // Generic software icon fallback
-        icon = gtk_image_new_from_icon_name("system-software-install", GTK_ICON_SIZE_DIALOG);
+static void render_details() {
+    if (!g_details_label) return;
+    if (g_details_shown_key.empty()) {
+        gtk_label_set_text(GTK_LABEL(g_details_label), "Select a package to see its details.");
+        return;
     }
-    gtk_box_pack_start(GTK_BOX(row), icon, FALSE, FALSE, 0);
 
-    // Text vbox
-    GtkWidget *text_vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
-
-    // First line: "<name> -- <version>" plus repo tag
-    std::string name_line = pkg.name + " -- " + pkg.version;
-    GtkWidget *name_label = gtk_label_new(name_line.c_str());
-    gtk_label_set_xalign(GTK_LABEL(name_label), 0.0);
+    const PackageInfo &pkg = g_details_shown_pkg;
+    std::string name(pkg.name), version(pkg.version), desc(pkg.description);
+    gchar *header = g_markup_printf_escaped("<big><b>%s</b></big>  %s\n%s\n", name.c_str(),
+                                            version.c_str(), desc.c_str());
+    std::string markup = header;
+    g_free(header);
+
+    auto it = g_details_cache.find(g_details_shown_key);
+    if (it == g_details_cache.end()) {
+        markup += g_details_pending.count(g_details_shown_key)
+            ? "\n<i>Loading details...</i>" : "\n<i>No details available.</i>";
+    } else {
+        for (const auto &field : it->second->fields) {
+            gchar *line = g_markup_printf_escaped("\n<b>%s</b>\n%s\n", field.first.c_str(),
+                                                  field.second.c_str());
+            markup += line;
+            g_free(line);
+        }
+    }
+    gtk_label_set_markup(GTK_LABEL(g_details_label), markup.c_str());
+}
 
-    std::string repo_tag = "[" + pkg.repo + "]";
-    GtkWidget *repo_label = gtk_label_new(repo_tag.c_str());
-    gtk_label_set_xalign(GTK_LABEL(repo_label), 0.0);
+// Store what came back for `batch`. Names missing from the reply are only
+// cached as "no details" when the call itself worked, so a failed or
+// offline lookup is retried next time.
+static void finish_details_batch(const std::vector<DetailsRequest> &batch, bool ok,
+                                 std::unordered_map<std::string, PackageDetails> &by_name) {
+    if (g_details_cache.size() + batch.size() > DETAILS_CACHE_MAX) g_details_cache.clear();
+
+    bool shown = false;
+    for (const auto &req : batch) {
+        g_details_pending.erase(req.key);
+        auto it = by_name.find(req.name);
+        if (it != by_name.end()) {
+            g_details_cache[req.key] = std::make_shared<PackageDetails>(std::move(it->second));
+        } else if (ok) {
+            g_details_cache[req.key] = std::make_shared<PackageDetails>();
+        }
+        if (req.key == g_details_shown_key) shown = true;
+    }
+    if (shown) render_details();
+}
 
-    GtkWidget *name_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
-    gtk_box_pack_start(GTK_BOX(name_row), name_label, FALSE, FALSE, 0);
-    gtk_box_pack_start(GTK_BOX(name_row), repo_label, FALSE, FALSE, 0);
+static gboolean flush_details_requests(gpointer) {
+    g_details_flush_id = 0;
 
-    // Description below
-    GtkWidget *desc_label = gtk_label_new(pkg.description.c_str());
-    gtk_label_set_xalign(GTK_LABEL(desc_label), 0.0);
-    gtk_label_set_line_wrap(GTK_LABEL(desc_label), TRUE);
+    for (int source = 0; source < 3; source++) {
+        if (g_details_queue[source].empty()) continue;
+        auto batch = std::make_shared<std::vector<DetailsRequest>>();
+        batch->swap(g_details_queue[source]);
 
-    gtk_box_pack_start(GTK_BOX(text_vbox), name_row, FALSE, FALSE, 0);
-    gtk_box_pack_start(GTK_BOX(text_vbox), desc_label, FALSE, FALSE, 0);
+        std::vector<std::string> targets;
+        for (const auto &req : *batch) targets.push_back(req.target);
 
-    gtk_box_pack_start(GTK_BOX(row), text_vbox, TRUE, TRUE, 0);
+        if (static_cast<DetailsSource>(source) == DetailsSource::Aur) {
+            aur_rpc_info(targets, [batch](bool ok, const std::vector<std::string> &replies) {
+                std::unordered_map<std::string, PackageDetails> by_name;
+                for (const auto &reply : replies) parse_aur_details(reply, by_name);
+                finish_details_batch(*batch, ok, by_name);
+            });
+            continue;
+        }
 
-    // Right side: Install or Remove button
-    if (pkg.installed) {
-        GtkWidget *btn = gtk_button_new_with_label("Remove");
-        char *pkg_name_copy = g_strdup(pkg.name.c_str());
-        g_signal_connect(btn, "clicked", G_CALLBACK(on_remove_clicked), pkg_name_copy);
-        gtk_box_pack_end(GTK_BOX(row), btn, FALSE, FALSE, 0);
-    } else {
-        GtkWidget *btn = gtk_button_new_with_label("Install");
-        char *pkg_name_copy = g_strdup(pkg.name.c_str());
-        g_signal_connect(btn, "clicked", G_CALLBACK(on_install_clicked), pkg_name_copy);
-        gtk_box_pack_end(GTK_BOX(row), btn, FALSE, FALSE, 0);
+        std::vector<std::string> argv = {
+            "pacman", static_cast<DetailsSource>(source) == DetailsSource::Local ? "-Qi" : "-Si",
+        };
+        argv.insert(argv.end(), targets.begin(), targets.end());
+        // Field names are matched, so keep them untranslated.
+        gchar **envp = g_environ_setenv(g_get_environ(), "LC_ALL", "C", TRUE);
+
+        auto reply = std::make_shared<std::string>();
+        ProcessCallbacks callbacks;
+        callbacks.on_stdout = [reply](const char *data, size_t len) { reply->append(data, len); };
+        callbacks.on_exit = [batch, reply](bool ok) {
+            std::unordered_map<std::string, PackageDetails> by_name;
+            // pacman exits non-zero if any one target is unknown.
+            parse_pacman_info(*reply, by_name);
+            finish_details_batch(*batch, ok || !by_name.empty(), by_name);
+        };
+        spawn_process(argv, std::move(callbacks), nullptr, nullptr, envp);
+        g_strfreev(envp);
     }
+    return G_SOURCE_REMOVE;
+}
 
-    gtk_box_pack_start(GTK_BOX(outer), row, FALSE, FALSE, 0);
+// Queue a details lookup for `pkg` unless it is cached or on its way.
+static void request_details(const PackageInfo &pkg) {
+    std::string key = details_key(pkg);
+    if (g_details_cache.count(key) || !g_details_pending.insert(key).second) return;
 
-    // Separator bar
-    GtkWidget *sep = gtk_separator_new(GTK_ORIENTATION_HORIZONTAL);
-    gtk_box_pack_start(GTK_BOX(outer), sep, FALSE, FALSE, 4);
+    DetailsSource source = details_source(pkg);
+    DetailsRequest req;
+    req.key = std::move(key);
+    req.name = std::string(pkg.name);
+    req.target = source == DetailsSource::Sync
+        ? std::string(pkg.repo_name()) + "/" + req.name : req.name;
+    g_details_queue[static_cast<int>(source)].push_back(std::move(req));
 
-    return outer;
+    if (!g_details_flush_id) g_details_flush_id = g_idle_add(flush_details_requests, nullptr);
 }
 
-void populate_results(const std::vector<PackageInfo> &pkgs) {
-    clear_results();
+// Show `pkg` in the pane, fetching its details (and its neighbours') if needed.
+static void show_details(const PackageInfo &pkg) {
+    g_details_shown_strings[0] = std::string(pkg.name);
+    g_details_shown_strings[1] = std::string(pkg.version);
+    g_details_shown_strings[2] = std::string(pkg.description);
+    g_details_shown_pkg = pkg;
+    g_details_shown_pkg.name = g_details_shown_strings[0];
+    g_details_shown_pkg.version = g_details_shown_strings[1];
+    g_details_shown_pkg.description = g_details_shown_strings[2];
+    g_details_shown_key = details_key(pkg);
+
+    request_details(pkg);
+    render_details();
+}
 
-    int total = 0;
-    int installed = 0;
+extern "C" void on_results_cursor_changed(GtkTreeView *view, gpointer) {
+    GtkTreePath *path = nullptr;
+    gtk_tree_view_get_cursor(view, &path, nullptr);
+    if (!path) return;
 
-    for (const auto &pkg : pkgs) {
-        total++;
-        if (pkg.installed) installed++;
+    GtkTreeModel *model = gtk_tree_view_get_model(view);
+    int row = gtk_tree_path_get_indices(path)[0];
+    gtk_tree_path_free(path);
 
-        GtkWidget *outer = create_package_row(pkg);
-        gtk_list_box_insert(GTK_LIST_BOX(g_results_list), outer, -1);
+    GtkTreeIter iter;
+    if (!gtk_tree_model_iter_nth_child(model, &iter, nullptr, row)) return;
+    if (const PackageInfo *pkg = package_at(model, &iter)) show_details(*pkg);
+
+    // Likely next: the rows around it.
+    for (int offset = -DETAILS_PREFETCH_ROWS; offset <= DETAILS_PREFETCH_ROWS; offset++) {
+        if (offset == 0 || row + offset < 0) continue;
+        if (!gtk_tree_model_iter_nth_child(model, &iter, nullptr, row + offset)) continue;
+        if (const PackageInfo *pkg = package_at(model, &iter)) request_details(*pkg);
     }
+}
 
-    gtk_widget_show_all(g_results_list);
+// The details pane, for the right side of the window.
+GtkWidget *create_details_pane() {
+    g_details_label = gtk_label_new(nullptr);
+    gtk_label_set_xalign(GTK_LABEL(g_details_label), 0.0);
+    gtk_label_set_yalign(GTK_LABEL(g_details_label), 0.0);
+    gtk_label_set_line_wrap(GTK_LABEL(g_details_label), TRUE);
+    gtk_label_set_selectable(GTK_LABEL(g_details_label), TRUE);
+    gtk_widget_set_margin_start(g_details_label, 10);
+    gtk_widget_set_margin_end(g_details_label, 10);
+    gtk_widget_set_margin_top(g_details_label, 6);
+    render_details();
 
-    if (g_status_label) {
-        std::string status = "Results: " + std::to_string(total) +
-                             "  | Installed: " + std::to_string(installed) +
-                             " (already on system)";
-        gtk_label_set_text(GTK_LABEL(g_status_label), status.c_str());
-    }
+    GtkWidget *scroll = gtk_scrolled_window_new(nullptr, nullptr);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll),
+                                   GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    gtk_widget_set_size_request(scroll, 280, -1);
+    gtk_container_add(GTK_CONTAINER(scroll), g_details_label);
+    return scroll;
 }
 
 // ───────────────────────────────────────────────
-//  Search logic
+//  Pacman DB monitors
 // ───────────────────────────────────────────────
 
-static void perform_search(const std::string &query) {
-    if (query.empty()) {
-        clear_results();
-        if (g_status_label)
-            gtk_label_set_text(GTK_LABEL(g_status_label), "Ready. Enter a search term.");
-        return;
-    }
+// Watch pacman's DB directories (inotify, via GFileMonitor) so changes made
+// outside the app are picked up too. Events come in bursts while pacman
+// works, so each kind is handled once things have been quiet for a moment.
+static const guint PACMAN_DB_SETTLE_MS = 750;
+
+// Kept for the lifetime of the app; dropping them stops the watch.
+static GFileMonitor *g_local_db_monitor = nullptr;
+static GFileMonitor *g_sync_db_monitor = nullptr;
+static guint g_local_db_settle_id = 0;
+static guint g_sync_db_settle_id = 0;
+
+static gboolean on_local_db_settled(gpointer) {
+    g_local_db_settle_id = 0;
+    refresh_installed_index();
+    if (!g_results.empty()) refresh_installed_flags();
+    g_details_cache.clear(); // install dates, required-by, ...
+    update_dependency_graph();
+    return G_SOURCE_REMOVE;
+}
 
-    std::string cmd = "yay -Ss " + query;
-    std::string raw_output = run_command(cmd);
-    std::string output = strip_ansi_and_osc(raw_output);
+static gboolean on_sync_db_settled(gpointer) {
+    g_sync_db_settle_id = 0;
+    // Cached results may list old versions or miss new packages.
+    g_search_cache.clear();
+    g_details_cache.clear();
+    rebuild_catalog();
+    return G_SOURCE_REMOVE;
+}
 
-    auto pkgs = parse_yay_search(output);
+static void restart_settle_timer(guint &id, GSourceFunc fn) {
+    if (id) g_source_remove(id);
+    id = g_timeout_add(PACMAN_DB_SETTLE_MS, fn, nullptr);
+}
 
-    // Double-check installed status with pacman so the Remove button is accurate
-    for (auto &pkg : pkgs) {
-        if (is_package_installed(pkg.name)) {
-            pkg.installed = true;
-        } else {
-            pkg.installed = false;
-        }
-    }
+extern "C" void on_local_db_changed(GFileMonitor *, GFile *, GFile *,
+                                    GFileMonitorEvent, gpointer) {
+    restart_settle_timer(g_local_db_settle_id, on_local_db_settled);
+}
 
-    populate_results(pkgs);
+extern "C" void on_sync_db_changed(GFileMonitor *, GFile *, GFile *,
+                                   GFileMonitorEvent, gpointer) {
+    restart_settle_timer(g_sync_db_settle_id, on_sync_db_settled);
+}
 
-    if (pkgs.empty() && g_status_label) {
-        gtk_label_set_text(GTK_LABEL(g_status_label), "No results found.");
+static GFileMonitor *monitor_directory(const char *path, GCallback handler) {
+    GFile *dir = g_file_new_for_path(path);
+    GFileMonitor *monitor = g_file_monitor_directory(dir, G_FILE_MONITOR_NONE, nullptr, nullptr);
+    g_object_unref(dir);
+    if (monitor) {
+        g_signal_connect(monitor, "changed", handler, nullptr);
+    } else {
+        g_printerr("Cannot watch %s; results may go stale until restart.\n", path);
     }
+    return monitor;
 }
 
-extern "C" void on_search_activated(GtkWidget *entry, gpointer) {
-    const char *text = gtk_entry_get_text(GTK_ENTRY(entry));
-    if (!text) return;
-    perform_search(text);
+void watch_pacman_dbs() {
+    g_local_db_monitor = monitor_directory(PACMAN_LOCAL_DB, G_CALLBACK(on_local_db_changed));
+    g_sync_db_monitor = monitor_directory(PACMAN_SYNC_DB, G_CALLBACK(on_sync_db_changed));
 }
 
 // ───────────────────────────────────────────────
 //  Password dialog
 // ───────────────────────────────────────────────
 
+// Asked for by the first privileged action (see sudo_password_available),
+// not at startup; g_sudo_password stays empty if the user cancels.
 void prompt_for_sudo_password() {
     GtkWidget *dialog = gtk_dialog_new_with_buttons(
         "Authentication Required",
         GTK_WINDOW(g_main_window),
         GTK_DIALOG_MODAL,
+        "_Cancel",
+        GTK_RESPONSE_CANCEL,
         "_OK",
         GTK_RESPONSE_OK,
-        "_Quit",
-        GTK_RESPONSE_CANCEL,
         nullptr
     );
+    gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_OK);
 
     GtkWidget *content = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
     GtkWidget *vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
@@ -683,6 +7552,7 @@ void prompt_for_sudo_password() {
     GtkWidget *entry = gtk_entry_new();
     gtk_entry_set_visibility(GTK_ENTRY(entry), FALSE);
     gtk_entry_set_invisible_char(GTK_ENTRY(entry), 0x2022);
+    gtk_entry_set_activates_default(GTK_ENTRY(entry), TRUE);
     gtk_box_pack_start(GTK_BOX(vbox), entry, FALSE, FALSE, 0);
 
     gtk_widget_show_all(dialog);
@@ -696,19 +7566,143 @@ void prompt_for_sudo_password() {
     }
 
     gtk_widget_destroy(dialog);
-
-    if (g_sudo_password.empty()) {
-        gtk_window_close(GTK_WINDOW(g_main_window));
-    }
 }
 
 // ───────────────────────────────────────────────
 //  App setup
 // ───────────────────────────────────────────────
 
-static void activate(GtkApplication *app, gpointer) {
+// --trace-overlay: the most recent timings, newest last, in the status bar.
+static GtkWidget *g_trace_overlay_label = nullptr;
+static const guint TRACE_OVERLAY_INTERVAL_MS = 500;
+static const size_t TRACE_OVERLAY_EVENTS = 4;
+
+static gboolean update_trace_overlay(gpointer) {
+    std::string text;
+    for (const auto &ev : trace_snapshot(TRACE_OVERLAY_EVENTS)) {
+        if (!text.empty()) text += "  ·  ";
+        text += format_trace_event(ev);
+    }
+    gtk_label_set_text(GTK_LABEL(g_trace_overlay_label), text.c_str());
+    return G_SOURCE_CONTINUE;
+}
+
+// Startup, in the order things happen: main() starts the worker lanes;
+// activate() queues the preloads (installed index, then the saved search
+// index) on the index lane and builds the window while they run; the
+// first frame is drawn; then what the window does not need to show up
+// (icon theme, DB monitors, dependency graph) runs from an idle. The sudo
+// password is asked for by the first privileged action. Milestones are
+// trace events measured from main(), and with tracing on they are also
+// printed as one line once the app is interactive: painted and able to
+// answer searches from the index.
+struct StartupTimes {
+    gint64 window = 0;       // built and shown
+    gint64 first_frame = 0;
+    gint64 installed = 0;    // installed index preloaded
+    gint64 catalog = 0;      // saved search index mapped (or found missing)
+};
+static StartupTimes g_startup;
+
+static void startup_milestone(gint64 StartupTimes::*slot, const char *what) {
+    if (!g_startup_us || g_startup.*slot) return;
+    g_startup.*slot = g_get_monotonic_time() - g_startup_us;
+    trace_record("startup", g_startup_us, what);
+
+    const StartupTimes &t = g_startup;
+    if (!tracing() || !t.first_frame || !t.installed || !t.catalog) return;
+    gint64 interactive = std::max({ t.first_frame, t.installed, t.catalog });
+    trace_record("startup", g_startup_us, "interactive");
+    g_printerr("Startup: window %.1f ms, first frame %.1f ms, installed index %.1f ms, "
+               "search index %.1f ms; interactive after %.1f ms\n",
+               t.window / 1000.0, t.first_frame / 1000.0, t.installed / 1000.0,
+               t.catalog / 1000.0, interactive / 1000.0);
+}
+
+static void preload_installed_index() {
+    auto index = std::make_shared<std::unordered_map<std::string, std::string>>();
+    auto job = std::make_shared<Job>();
+    job->work = [index](Job &) {
+        TraceScope trace("preload installed index");
+        read_installed_index(*index);
+    };
+    job->finished = [index](Job &self) {
+        // A lookup that could not wait has built it already; that one is as current.
+        if (!self.cancelled && !g_installed_index_valid) {
+            set_installed_index(std::move(*index));
+            if (!g_results.empty()) refresh_installed_flags();
+        }
+        startup_milestone(&StartupTimes::installed, "installed index");
+    };
+    g_index_jobs->submit(job);
+}
+
+// Search from the index saved last time, if there is one, and rebuild it
+// in the background if the pacman DBs changed since; yay answers until an
+// index is available.
+static void preload_catalog() {
+    auto loaded = std::make_shared<std::shared_ptr<Catalog>>();
+    auto job = std::make_shared<Job>();
+    job->work = [loaded](Job &) {
+        TraceScope trace("preload catalog cache");
+        *loaded = load_catalog_cache(catalog_cache_path());
+    };
+    job->finished = [loaded](Job &self) {
+        if (!self.cancelled && *loaded && !g_catalog) g_catalog = std::move(*loaded);
+        startup_milestone(&StartupTimes::catalog, g_catalog ? "search index" : "no saved search index");
+        rebuild_catalog_if_stale();
+        refresh_aur_metadata();
+    };
+    g_index_jobs->submit(job);
+}
+
+static gboolean finish_startup(gpointer) {
+    {
+        // Reading the theme's index is what makes the first icon lookup slow.
+        TraceScope trace("preload icon theme");
+        gtk_icon_theme_has_icon(gtk_icon_theme_get_default(), FALLBACK_ICON);
+    }
+    watch_pacman_dbs();
+    update_dependency_graph();
+    return G_SOURCE_REMOVE;
+}
+
+extern "C" gboolean on_first_frame_drawn(GtkWidget *widget, cairo_t *, gpointer) {
+    g_signal_handlers_disconnect_by_func(widget, reinterpret_cast<gpointer>(on_first_frame_drawn), nullptr);
+    startup_milestone(&StartupTimes::first_frame, "first frame");
+    g_idle_add(finish_startup, nullptr);
+    return FALSE;
+}
+
+// Closing the window does not cut a transaction short: the window is
+// hidden and the app held until the transaction lane is empty (its result
+// dialogs still show), then the window goes and the app quits.
+extern "C" gboolean on_main_window_delete(GtkWidget *window, GdkEvent *, gpointer user_data) {
+    if (!g_transactions.busy()) return FALSE;
+    GApplication *app = G_APPLICATION(user_data);
+    gtk_widget_hide(window);
+    g_application_hold(app);
+    g_transactions.when_idle([app, window] {
+        gtk_widget_destroy(window);
+        g_application_release(app);
+    });
+    return TRUE;
+}
+
+void activate(GtkApplication *app, gpointer) {
+    // Started again while running: GApplication passed the activation to
+    // this instance, which already has its window.
+    if (g_main_window) {
+        gtk_window_present(GTK_WINDOW(g_main_window));
+        return;
+    }
+
+    preload_installed_index();
+    preload_catalog();
+
     g_main_window = gtk_application_window_new(app);
     gtk_window_set_default_size(GTK_WINDOW(g_main_window), 900, 600);
+    g_signal_connect(g_main_window, "delete-event", G_CALLBACK(on_main_window_delete), app);
 
     // Header bar so it feels like a proper system tool
     GtkWidget *header = gtk_header_bar_new();
@@ -729,28 +7723,40 @@ static void activate(GtkApplication *app, gpointer) {
 
     g_search_entry = gtk_entry_new();
     gtk_entry_set_placeholder_text(GTK_ENTRY(g_search_entry),
-                                   "Search packages (via yay -Ss)...");
+                                   "Search packages...");
     g_signal_connect(g_search_entry, "activate", G_CALLBACK(on_search_activated), nullptr);
+    g_signal_connect(g_search_entry, "changed", G_CALLBACK(on_search_changed), nullptr);
 
     GtkWidget *search_button = gtk_button_new_with_label("Search");
     g_signal_connect_swapped(search_button, "clicked",
                              G_CALLBACK(on_search_activated),
                              g_search_entry);
 
+    GtkWidget *updates_button = gtk_button_new_with_label("Updates");
+    g_signal_connect(updates_button, "clicked", G_CALLBACK(on_updates_clicked), nullptr);
+
     gtk_box_pack_start(GTK_BOX(search_box), g_search_entry, TRUE, TRUE, 0);
     gtk_box_pack_start(GTK_BOX(search_box), search_button, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(search_box), updates_button, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(vbox), search_box, FALSE, FALSE, 0);
 
     // Results list in scrolled window
-    g_results_list = gtk_list_box_new();
-    gtk_list_box_set_selection_mode(GTK_LIST_BOX(g_results_list), GTK_SELECTION_NONE);
+    g_results_list = create_results_view();
 
     GtkWidget *scroll = gtk_scrolled_window_new(nullptr, nullptr);
     gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll),
                                    GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
     gtk_container_add(GTK_CONTAINER(scroll), g_results_list);
+    g_signal_connect(scroll, "edge-reached", G_CALLBACK(on_results_edge_reached), nullptr);
 
-    gtk_box_pack_start(GTK_BOX(vbox), scroll, TRUE, TRUE, 0);
+    // Details of the row under the cursor on the right.
+    GtkWidget *paned = gtk_paned_new(GTK_ORIENTATION_HORIZONTAL);
+    gtk_paned_pack1(GTK_PANED(paned), scroll, TRUE, FALSE);
+    gtk_paned_pack2(GTK_PANED(paned), create_details_pane(), FALSE, FALSE);
+    gtk_box_pack_start(GTK_BOX(vbox), paned, TRUE, TRUE, 0);
+
+    // Output of the running (and earlier) commands, collapsed by default.
+    gtk_box_pack_start(GTK_BOX(vbox), create_log_pane(), FALSE, FALSE, 0);
 
     // Status bar + Clean Orphans button at bottom
     GtkWidget *status_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
@@ -768,22 +7774,347 @@ static void activate(GtkApplication *app, gpointer) {
                      G_CALLBACK(on_clean_orphans_clicked), nullptr);
     gtk_box_pack_end(GTK_BOX(status_box), clean_button, FALSE, FALSE, 0);
 
+    GtkWidget *cache_button = gtk_button_new_with_label("Package Cache");
+    g_signal_connect(cache_button, "clicked",
+                     G_CALLBACK(on_package_cache_clicked), nullptr);
+    gtk_box_pack_end(GTK_BOX(status_box), cache_button, FALSE, FALSE, 0);
+
+    // Only while the Updates view has something to upgrade.
+    g_upgrade_button = gtk_button_new_with_label("Upgrade All");
+    gtk_widget_set_no_show_all(g_upgrade_button, TRUE);
+    g_signal_connect(g_upgrade_button, "clicked",
+                     G_CALLBACK(on_upgrade_all_clicked), nullptr);
+    gtk_box_pack_end(GTK_BOX(status_box), g_upgrade_button, FALSE, FALSE, 0);
+
+    // Multi-select rows (Ctrl/Shift-click), queue them, apply in one go.
+    g_apply_queue_button = gtk_button_new_with_label("");
+    g_signal_connect(g_apply_queue_button, "clicked",
+                     G_CALLBACK(on_apply_queue_clicked), nullptr);
+    gtk_box_pack_end(GTK_BOX(status_box), g_apply_queue_button, FALSE, FALSE, 0);
+    update_queue_button();
+
+    GtkWidget *queue_button = gtk_button_new_with_label("Queue Selected");
+    g_signal_connect(queue_button, "clicked",
+                     G_CALLBACK(on_queue_selected_clicked), nullptr);
+    gtk_box_pack_end(GTK_BOX(status_box), queue_button, FALSE, FALSE, 0);
+
+    if (g_trace_overlay) {
+        g_trace_overlay_label = gtk_label_new("");
+        gtk_label_set_ellipsize(GTK_LABEL(g_trace_overlay_label), PANGO_ELLIPSIZE_START);
+        gtk_style_context_add_class(gtk_widget_get_style_context(g_trace_overlay_label), "dim-label");
+        gtk_box_pack_end(GTK_BOX(status_box), g_trace_overlay_label, TRUE, TRUE, 8);
+        g_timeout_add(TRACE_OVERLAY_INTERVAL_MS, update_trace_overlay, nullptr);
+    }
+
     gtk_box_pack_end(GTK_BOX(vbox), status_box, FALSE, FALSE, 0);
 
+    g_signal_connect_after(g_main_window, "draw", G_CALLBACK(on_first_frame_drawn), nullptr);
     gtk_widget_show_all(g_main_window);
+    startup_milestone(&StartupTimes::window, "window");
+}
 
-    // Prompt for sudo password once
-    prompt_for_sudo_password();
+// bench.cpp includes this file with COLOSSUS_NO_MAIN and brings its own main.
+#ifndef COLOSSUS_NO_MAIN
+
+// Our own options; GApplication gets the rest.
+static void parse_trace_options(int &argc, char **argv) {
+    int kept = 1;
+    for (int i = 1; i < argc; i++) {
+        if (g_str_has_prefix(argv[i], "--trace=")) {
+            g_trace_file = argv[i] + strlen("--trace=");
+        } else if (strcmp(argv[i], "--trace-overlay") == 0) {
+            g_trace_overlay = true;
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc = kept;
+    argv[argc] = nullptr;
+
+    bool on = !g_trace_file.empty() || g_trace_overlay;
+#ifdef COLOSSUS_WITH_SYSPROF
+    on = on || g_getenv("SYSPROF_CONTROL_FD"); // launched from sysprof
+#endif
+    g_trace_enabled = on;
 }
 
-int main(int argc, char **argv) {
-    GtkApplication *app = gtk_application_new(
-        "tech.will.colossus.pkgcenter",
-        G_APPLICATION_DEFAULT_FLAGS
-    );
-    g_signal_connect(app, "activate", G_CALLBACK(activate), nullptr);
-    int status = g_application_run(G_APPLICATION(app), argc, argv);
+// ───────────────────────────────────────────────
+//  Command line and D-Bus service
+// ───────────────────────────────────────────────
+
+// The same engine without a window, and without initializing GTK:
+//   --search TERM...   matches, best first, printed like `yay -Ss`
+//   --install PKG...   `yay -S --needed` on this terminal
+//   --service          keep the index and installed set loaded, on the
+//                      session bus as ENGINE_BUS_NAME, until idle
+// --search asks a running service first, so repeated queries from scripts
+// or other tools are answered from memory; without one it maps the saved
+// index itself. Anything the index cannot answer (regular expressions, no
+// index yet) is handed to yay.
+static const char *ENGINE_BUS_NAME    = "tech.will.colossus.pkgcenter.Engine";
+static const char *ENGINE_OBJECT_PATH = "/tech/will/colossus/pkgcenter/Engine";
+static const char *ENGINE_INTERFACE   = "tech.will.colossus.pkgcenter.Engine";
+static const char ENGINE_INTERFACE_XML[] =
+    "<node>"
+    "  <interface name='tech.will.colossus.pkgcenter.Engine'>"
+    "    <method name='Search'>"
+    "      <arg type='s' name='query' direction='in'/>"
+    "      <arg type='a(ssssbu)' name='results' direction='out'/>"  // repo, name, version,
+    "    </method>"                                                  // description, installed, votes
+    "    <method name='InstalledVersion'>"
+    "      <arg type='s' name='name' direction='in'/>"
+    "      <arg type='s' name='version' direction='out'/>"          // "" when not installed
+    "    </method>"
+    "  </interface>"
+    "</node>";
+static const guint ENGINE_IDLE_EXIT_MS = 15 * 60 * 1000;
+static const gint ENGINE_CALL_TIMEOUT_MS = 10000;   // room for an AUR round trip
+
+// `query` answered from the index (plus the AUR RPC when the index has no
+// AUR dump), ranked as in the window. False when it has to go to yay.
+static bool engine_search(const std::string &query, std::function<void(PackageList &pkgs)> on_done) {
+    std::vector<std::string> terms = split_search_terms(query);
+    if (terms.empty() || terms_need_regex(terms) || !g_catalog || !g_catalog->complete) return false;
+    std::vector<std::string> folded = fold_terms(terms);
+
+    auto pkgs = std::make_shared<PackageList>();
+    {
+        TraceScope trace("catalog search");
+        for (uint32_t id : g_catalog->search(folded)) pkgs->items.push_back(g_catalog->package(id));
+        pkgs->keep(g_catalog);
+    }
+
+    auto finish = [pkgs, folded, on_done]() {
+        std::vector<int32_t> scores;
+        std::string name;
+        for (auto &pkg : pkgs->items) {
+            pkg.set_installed(is_package_installed(pkg.name));
+            scores.push_back(score_match(pkg, folded, name));
+        }
+        std::vector<uint32_t> order(pkgs->size());
+        for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+        std::stable_sort(order.begin(), order.end(),
+                         [&scores](uint32_t a, uint32_t b) { return scores[a] > scores[b]; });
+
+        PackageList ranked;
+        for (uint32_t i : order) ranked.items.push_back(pkgs->items[i]);
+        ranked.keep_storage_of(*pkgs);
+        on_done(ranked);
+    };
+    if (g_catalog->has_aur) {
+        finish();
+        return true;
+    }
+    aur_rpc_search(terms, [pkgs, finish](bool ok, PackageList &aur, const std::string &) {
+        if (!ok) g_printerr("AUR search failed; showing repo results only.\n");
+        pkgs->append(aur);
+        finish();
+    });
+    return true;
+}
+
+static void print_search_result(const char *repo, const char *name, const char *version,
+                                const char *description, bool installed) {
+    printf("%s/%s %s%s\n    %s\n", repo, name, version, installed ? " [installed]" : "", description);
+}
+
+// Replace this process with `args`, searched for in PATH.
+static int exec_command(const std::vector<std::string> &args) {
+    std::vector<char *> argv;
+    for (const auto &arg : args) argv.push_back(const_cast<char *>(arg.c_str()));
+    argv.push_back(nullptr);
+    fflush(stdout);
+    execvp(argv[0], argv.data());
+    g_printerr("Cannot run %s: %s\n", argv[0], g_strerror(errno));
+    return 127;
+}
+
+// Ask a running --service. False when there is none or it cannot answer.
+static bool search_via_service(const std::string &query, size_t &found) {
+    GDBusConnection *bus = g_bus_get_sync(G_BUS_TYPE_SESSION, nullptr, nullptr);
+    if (!bus) return false;
+    GVariant *reply = g_dbus_connection_call_sync(
+        bus, ENGINE_BUS_NAME, ENGINE_OBJECT_PATH, ENGINE_INTERFACE, "Search",
+        g_variant_new("(s)", query.c_str()), G_VARIANT_TYPE("(a(ssssbu))"),
+        G_DBUS_CALL_FLAGS_NO_AUTO_START, ENGINE_CALL_TIMEOUT_MS, nullptr, nullptr);
+    g_object_unref(bus);
+    if (!reply) return false;
+
+    GVariantIter *results = nullptr;
+    g_variant_get(reply, "(a(ssssbu))", &results);
+    const gchar *repo, *name, *version, *description;
+    gboolean installed;
+    guint32 votes;
+    while (g_variant_iter_loop(results, "(&s&s&s&sbu)", &repo, &name, &version,
+                               &description, &installed, &votes)) {
+        print_search_result(repo, name, version, description, installed);
+        found++;
+    }
+    g_variant_iter_free(results);
+    g_variant_unref(reply);
+    return true;
+}
+
+// Exit status as pacman -Ss: 0 with matches, 1 without.
+static int run_search_command(const std::vector<std::string> &terms) {
+    std::string query;
+    for (const auto &term : terms) query += (query.empty() ? "" : " ") + term;
+
+    size_t found = 0;
+    if (search_via_service(query, found)) return found ? 0 : 1;
+
+    g_catalog = load_catalog_cache(catalog_cache_path());
+    if (g_catalog && catalog_is_stale()) {
+        g_printerr("The saved index is older than the sync DBs; open the app or "
+                   "run --service to rebuild it.\n");
+    }
+
+    GMainLoop *loop = g_main_loop_new(nullptr, FALSE);
+    bool done = false;
+    bool answered = engine_search(query, [&](PackageList &pkgs) {
+        for (const auto &pkg : pkgs.items) {
+            print_search_result(std::string(pkg.repo_name()).c_str(), std::string(pkg.name).c_str(),
+                                std::string(pkg.version).c_str(),
+                                std::string(pkg.description).c_str(), pkg.installed());
+        }
+        found = pkgs.size();
+        done = true;
+        g_main_loop_quit(loop);
+    });
+    if (answered && !done) g_main_loop_run(loop);
+    g_main_loop_unref(loop);
+
+    if (!answered) {
+        std::vector<std::string> argv = { "yay", "-Ss" };
+        argv.insert(argv.end(), terms.begin(), terms.end());
+        return exec_command(argv);
+    }
+    return found ? 0 : 1;
+}
+
+extern "C" void on_engine_method_call(GDBusConnection *, const gchar *, const gchar *,
+                                      const gchar *, const gchar *method_name,
+                                      GVariant *parameters, GDBusMethodInvocation *invocation,
+                                      gpointer user_data) {
+    // Every call restarts the idle countdown.
+    GApplication *app = G_APPLICATION(user_data);
+    g_application_hold(app);
+
+    const gchar *arg = nullptr;
+    g_variant_get(parameters, "(&s)", &arg);
+
+    if (g_strcmp0(method_name, "InstalledVersion") == 0) {
+        const std::string *version = installed_version(arg);
+        g_dbus_method_invocation_return_value(invocation,
+            g_variant_new("(s)", version ? version->c_str() : ""));
+        g_application_release(app);
+        return;
+    }
+
+    rebuild_catalog_if_stale(); // this answer still comes from the current one
+    bool answered = engine_search(arg, [app, invocation](PackageList &pkgs) {
+        GVariantBuilder results;
+        g_variant_builder_init(&results, G_VARIANT_TYPE("a(ssssbu)"));
+        for (const auto &pkg : pkgs.items) {
+            g_variant_builder_add(&results, "(ssssbu)",
+                                  std::string(pkg.repo_name()).c_str(), std::string(pkg.name).c_str(),
+                                  std::string(pkg.version).c_str(),
+                                  std::string(pkg.description).c_str(),
+                                  static_cast<gboolean>(pkg.installed()), pkg.votes);
+        }
+        g_dbus_method_invocation_return_value(invocation, g_variant_new("(a(ssssbu))", &results));
+        g_application_release(app);
+    });
+    if (!answered) {
+        g_dbus_method_invocation_return_error_literal(invocation, G_DBUS_ERROR,
+            G_DBUS_ERROR_NOT_SUPPORTED,
+            "Not answerable from the index (regular expression, or no index yet); use yay -Ss");
+        g_application_release(app);
+    }
+}
+
+extern "C" void on_service_startup(GApplication *app, gpointer) {
+    static const GDBusInterfaceVTable vtable = { on_engine_method_call, nullptr, nullptr, { nullptr } };
+    GDBusNodeInfo *node = g_dbus_node_info_new_for_xml(ENGINE_INTERFACE_XML, nullptr);
+    GDBusConnection *bus = g_application_get_dbus_connection(app);
+    GError *error = nullptr;
+    if (!bus || !g_dbus_connection_register_object(bus, ENGINE_OBJECT_PATH, node->interfaces[0],
+                                                   &vtable, app, nullptr, &error)) {
+        g_printerr("Cannot export the engine on the session bus: %s\n",
+                   error ? error->message : "not connected");
+        g_clear_error(&error);
+    }
+    g_dbus_node_info_unref(node);
+
+    // As the window does at startup, minus the window.
+    g_catalog = load_catalog_cache(catalog_cache_path());
+    rebuild_catalog_if_stale();
+    refresh_aur_metadata();
+    watch_pacman_dbs();
+    refresh_installed_index();
+}
+
+static int run_service(char *argv0) {
+    GApplication *app = g_application_new(ENGINE_BUS_NAME, G_APPLICATION_IS_SERVICE);
+    g_application_set_inactivity_timeout(app, ENGINE_IDLE_EXIT_MS);
+    g_signal_connect(app, "startup", G_CALLBACK(on_service_startup), nullptr);
+    char *args[] = { argv0, nullptr };
+    int status = g_application_run(app, 1, args);
     g_object_unref(app);
     return status;
 }
 
+static bool is_headless_option(const char *arg) {
+    return strcmp(arg, "--search") == 0 || strcmp(arg, "--install") == 0 ||
+           strcmp(arg, "--service") == 0;
+}
+
+static int run_headless(int argc, char **argv) {
+    std::string command = argv[1];
+    std::vector<std::string> args(argv + 2, argv + argc);
+    if (command == "--service" && args.empty()) return run_service(argv[0]);
+    if (command == "--service" || args.empty()) {
+        g_printerr("Usage: %s --search TERM... | --install PKG... | --service\n", argv[0]);
+        return 2;
+    }
+    if (command == "--search") return run_search_command(args);
+
+    std::vector<std::string> yay = { "yay", "-S", "--needed" };
+    yay.insert(yay.end(), args.begin(), args.end());
+    return exec_command(yay);
+}
+
+int main(int argc, char **argv) {
+    g_startup_us = g_get_monotonic_time();
+    parse_trace_options(argc, argv);
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    g_search_jobs = new JobQueue();
+    g_index_jobs = new JobQueue();
+    g_aur_jobs = new JobQueue();
+
+    int status;
+    if (argc > 1 && is_headless_option(argv[1])) {
+        status = run_headless(argc, argv);
+    } else {
+        GtkApplication *app = gtk_application_new(
+            "tech.will.colossus.pkgcenter",
+            G_APPLICATION_DEFAULT_FLAGS
+        );
+        g_signal_connect(app, "activate", G_CALLBACK(activate), nullptr);
+        status = g_application_run(G_APPLICATION(app), argc, argv);
+        g_object_unref(app);
+    }
+
+    // Transactions have finished by now (on_main_window_delete waits for
+    // them). What is left on the job lanes is cancelled and their threads
+    // joined, see ~JobQueue.
+    delete g_search_jobs;
+    delete g_index_jobs;
+    delete g_aur_jobs;
+
+    if (!g_trace_file.empty()) write_chrome_trace(g_trace_file);
+    return status;
+}
+
+#endif // COLOSSUS_NO_MAIN
@@ -44,8 +44,8 @@ fi
 #  Install dependencies
 # ───────────────────────────────────────────────
 
-echo "==> Installing dependencies (gtk3, base-devel, pkgconf)..."
-pacman -Syu --needed --noconfirm gtk3 base-devel pkgconf
+echo "==> Installing dependencies (gtk3, curl, base-devel, pkgconf)..."
+pacman -Syu --needed --noconfirm gtk3 curl base-devel pkgconf
 
 # We DON'T auto-install yay, but we warn if it's missing.
 if ! command -v yay >/dev/null 2>&1; then